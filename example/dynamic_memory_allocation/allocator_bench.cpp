@@ -0,0 +1,343 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <memory_resource>
+#include <new>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "gtest_wrapper.h"
+
+#include "dynamic_memory_allocation_ut.h"
+#include "malloc_free.h"
+#include "mpool_fixed.h"
+#include "mpool_variable.h"
+#include "utils.h"
+
+// *_bench.cppは../dynamic_memory_allocation_bench/Makefileでビルドし、単体テストには含めない。
+// 同じバイナリにglobal_new_delete.cppがリンクされるため、
+// グローバルnew/deleteを経由するstd::vector等でのメモリ確保は計測の外でのみ行う
+
+namespace {
+
+// @@@ sample begin 0:0
+
+constexpr uint32_t max_threads{8};
+constexpr uint32_t loops{4096};  // 1スレッドが行うalloc/freeの組の数
+constexpr uint32_t live{16};     // 1スレッドが同時に保持するメモリの数
+constexpr size_t   fixed_size{32};
+constexpr size_t   size_min{16};
+constexpr size_t   size_max{1024};
+
+struct bench_allocator {
+    char const* name;
+    void* (*alloc)(size_t size) noexcept;  // 失敗時はnullptr
+    void (*free)(void* mem, size_t size) noexcept;
+    bool random_size;   // fixed_size以外も扱えるか
+    bool cross_thread;  // 他のスレッドが確保したメモリを解放できるか
+};
+
+enum class pattern { fixed, random, producer_consumer };
+// @@@ sample end
+
+// pmrのプールの上流。グローバルnew/deleteのオーバーロードを避け、glibcのmallocから得る
+class MallocResource final : public std::pmr::memory_resource {
+private:
+    void* do_allocate(size_t bytes, size_t) override
+    {
+        if (auto mem = std::malloc(bytes); mem != nullptr) {
+            return mem;
+        }
+        throw std::bad_alloc{};
+    }
+
+    void do_deallocate(void* mem, size_t, size_t) override { std::free(mem); }
+    bool do_is_equal(std::pmr::memory_resource const& other) const noexcept override { return this == &other; }
+};
+
+MallocResource malloc_resource;
+
+MPoolFixed<fixed_size, 4096>   mpf;
+MPoolVariable<4 * 1024 * 1024> mpv;
+
+std::pmr::synchronized_pool_resource& sync_resource()
+{
+    static std::pmr::synchronized_pool_resource resource{&malloc_resource};
+
+    return resource;
+}
+
+// unsynchronized_pool_resourceはスレッド間で共有できないため、スレッド毎に持つ
+std::pmr::unsynchronized_pool_resource& unsync_resource()
+{
+    thread_local std::pmr::unsynchronized_pool_resource resource{&malloc_resource};
+
+    return resource;
+}
+
+template <typename F>
+void* no_throw(F&& f) noexcept
+{
+    try {
+        return f();
+    }
+    catch (std::bad_alloc const&) {
+        return nullptr;
+    }
+}
+
+// @@@ sample begin 1:0
+
+bench_allocator const allocators[]{
+    {"MPoolFixed", [](size_t size) noexcept { return mpf.AllocNoExcept(size); },
+     [](void* mem, size_t) noexcept { mpf.Free(mem); }, false, true},
+    {"MPoolVariable", [](size_t size) noexcept { return mpv.AllocNoExcept(size); },
+     [](void* mem, size_t) noexcept { mpv.Free(mem); }, true, true},
+    {"MallocFree", [](size_t size) noexcept { return MallocFree::malloc(size); },
+     [](void* mem, size_t) noexcept { MallocFree::free(mem); }, true, true},
+    {"global_new", [](size_t size) noexcept { return ::operator new(size, std::nothrow); },
+     [](void* mem, size_t) noexcept { ::operator delete(mem); }, true, true},
+    {"unsync_pool_resource",
+     [](size_t size) noexcept { return no_throw([size] { return unsync_resource().allocate(size); }); },
+     [](void* mem, size_t size) noexcept { unsync_resource().deallocate(mem, size); }, true, false},
+    {"sync_pool_resource",
+     [](size_t size) noexcept { return no_throw([size] { return sync_resource().allocate(size); }); },
+     [](void* mem, size_t size) noexcept { sync_resource().deallocate(mem, size); }, true, true},
+    {"glibc_malloc", [](size_t size) noexcept { return std::malloc(size); },
+     [](void* mem, size_t) noexcept { std::free(mem); }, true, true},
+};
+// @@@ sample end
+
+size_t random_sizes[loops];  // 全スレッドで共通のランダムなサイズ列
+
+// LATENCYがtrueの場合、1回毎の所要時間[ns]をlatency[t]に記録する
+uint32_t latency[max_threads][2 * loops];
+uint32_t latency_count[max_threads];
+uint32_t latency_all[max_threads * 2 * loops];
+
+using clock = std::chrono::steady_clock;
+
+template <bool LATENCY, typename F>
+auto timed(uint32_t t, F&& f) noexcept
+{
+    if constexpr (LATENCY) {
+        auto const begin  = clock::now();
+        auto const result = f();
+
+        latency[t][latency_count[t]++]
+            = static_cast<uint32_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() - begin).count());
+
+        return result;
+    }
+    else {
+        return f();
+    }
+}
+
+// 各スレッドはlive個のスロットを回し、古いメモリを解放してから新しいメモリを確保する
+template <bool LATENCY>
+void alloc_free_loop(bench_allocator const& a, bool random, uint32_t t, std::atomic<uint32_t>& failed) noexcept
+{
+    void*  mem[live]{};
+    size_t size[live]{};
+
+    for (auto i = 0U; i < loops; ++i) {
+        auto const slot = i % live;
+
+        if (mem[slot] != nullptr) {
+            timed<LATENCY>(t, [&] {
+                a.free(mem[slot], size[slot]);
+                return true;
+            });
+        }
+
+        size[slot] = random ? random_sizes[(i + t * 97) % loops] : fixed_size;
+        mem[slot]  = timed<LATENCY>(t, [&] { return a.alloc(size[slot]); });
+
+        if (mem[slot] == nullptr) {
+            failed.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    for (auto i = 0U; i < live; ++i) {
+        if (mem[i] != nullptr) {
+            a.free(mem[i], size[i]);
+        }
+    }
+}
+
+// 生産者が確保したメモリを消費者が解放する。生産者と消費者は1対1
+struct alignas(64) spsc_queue {
+    static constexpr uint32_t capacity{64};
+
+    void*                             buff[capacity];
+    alignas(64) std::atomic<uint32_t> head;  // 消費者が進める
+    alignas(64) std::atomic<uint32_t> tail;  // 生産者が進める
+};
+
+spsc_queue queues[max_threads / 2];
+
+template <bool LATENCY>
+void producer(bench_allocator const& a, uint32_t t, spsc_queue& q, std::atomic<uint32_t>& failed) noexcept
+{
+    for (auto i = 0U; i < loops; ++i) {
+        auto mem = timed<LATENCY>(t, [&] { return a.alloc(fixed_size); });
+
+        if (mem == nullptr) {
+            failed.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        auto const tail = q.tail.load(std::memory_order_relaxed);
+
+        while (tail - q.head.load(std::memory_order_acquire) == spsc_queue::capacity) {
+            std::this_thread::yield();
+        }
+
+        q.buff[tail % spsc_queue::capacity] = mem;
+        q.tail.store(tail + 1, std::memory_order_release);
+    }
+}
+
+template <bool LATENCY>
+void consumer(bench_allocator const& a, uint32_t t, spsc_queue& q) noexcept
+{
+    for (auto i = 0U; i < loops; ++i) {
+        auto const head = q.head.load(std::memory_order_relaxed);
+
+        while (q.tail.load(std::memory_order_acquire) == head) {
+            std::this_thread::yield();
+        }
+
+        auto mem = q.buff[head % spsc_queue::capacity];
+        q.head.store(head + 1, std::memory_order_release);
+
+        if (mem != nullptr) {
+            timed<LATENCY>(t, [&] {
+                a.free(mem, fixed_size);
+                return true;
+            });
+        }
+    }
+}
+
+// 全スレッドの経過時間[ns]
+template <bool LATENCY>
+double run(bench_allocator const& a, pattern p, uint32_t n_threads, std::atomic<uint32_t>& failed)
+{
+    auto start = std::atomic<bool>{false};
+    auto ths   = std::vector<std::thread>{};
+
+    ths.reserve(n_threads);
+
+    for (auto& q : queues) {
+        q.head = 0;
+        q.tail = 0;
+    }
+
+    for (auto t = 0U; t < n_threads; ++t) {
+        latency_count[t] = 0;
+
+        ths.emplace_back([&a, &start, &failed, p, t] {
+            while (!start.load(std::memory_order_acquire)) {
+                std::this_thread::yield();
+            }
+
+            switch (p) {
+            case pattern::fixed:
+                alloc_free_loop<LATENCY>(a, false, t, failed);
+                break;
+            case pattern::random:
+                alloc_free_loop<LATENCY>(a, true, t, failed);
+                break;
+            case pattern::producer_consumer:
+                if (t % 2 == 0) {
+                    producer<LATENCY>(a, t, queues[t / 2], failed);
+                }
+                else {
+                    consumer<LATENCY>(a, t, queues[t / 2]);
+                }
+                break;
+            }
+        });
+    }
+
+    auto const begin = clock::now();
+    start.store(true, std::memory_order_release);
+
+    for (auto& th : ths) {
+        th.join();
+    }
+
+    return std::chrono::duration<double, std::nano>(clock::now() - begin).count();
+}
+
+double p99(uint32_t n_threads) noexcept
+{
+    auto n = 0U;
+
+    for (auto t = 0U; t < n_threads; ++t) {
+        n = std::copy(&latency[t][0], &latency[t][latency_count[t]], &latency_all[n]) - &latency_all[0];
+    }
+
+    auto const nth = &latency_all[n * 99 / 100];
+    std::nth_element(&latency_all[0], nth, &latency_all[n]);
+
+    return *nth;
+}
+
+char const* to_str(pattern p) noexcept
+{
+    switch (p) {
+    case pattern::fixed:
+        return "fixed";
+    case pattern::random:
+        return "random";
+    case pattern::producer_consumer:
+        return "producer_consumer";
+    }
+
+    return "";
+}
+
+TEST(NewDelete_Opt, allocator_benchmark)
+{
+    // @@@ sample begin 2:0
+
+    auto rng = std::mt19937{3};
+    for (auto& s : random_sizes) {
+        s = size_min + rng() % (size_max - size_min + 1);
+    }
+
+    // 1行1計測のCSV。ns_per_opは全スレッドの(alloc + free)の回数で経過時間を割ったもの
+    std::cout << "allocator,pattern,threads,ns_per_op,p99_ns,failed" << std::endl;
+
+    for (auto const& a : allocators) {
+        for (auto p : {pattern::fixed, pattern::random, pattern::producer_consumer}) {
+            if ((p == pattern::random && !a.random_size) || (p == pattern::producer_consumer && !a.cross_thread)) {
+                continue;
+            }
+
+            for (auto n_threads = p == pattern::producer_consumer ? 2U : 1U; n_threads <= max_threads; n_threads *= 2) {
+                auto       failed  = std::atomic<uint32_t>{0};
+                auto const ops     = 2.0 * loops * (p == pattern::producer_consumer ? n_threads / 2 : n_threads);
+                auto const elapsed = run<false>(a, p, n_threads, failed);  // 計測のオーバーヘッドを含めない
+
+                auto failed_latency = std::atomic<uint32_t>{0};  // 1回目と同じ結果になるため出力しない
+                run<true>(a, p, n_threads, failed_latency);
+
+                std::cout << a.name << ',' << to_str(p) << ',' << n_threads << ',' << std::fixed
+                          << std::setprecision(1) << elapsed / ops << ',' << p99(n_threads) << ','
+                          << failed.load() << std::endl;
+            }
+        }
+    }
+
+    ASSERT_EQ(fixed_size, mpf.GetSize());
+    ASSERT_EQ(4096, mpf.GetCount());  // 全て返却されている
+    // @@@ sample end
+}
+}  // namespace
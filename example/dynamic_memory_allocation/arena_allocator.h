@@ -0,0 +1,69 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <type_traits>
+
+#include "mpool.h"
+#include "mpool_arena.h"
+
+// @@@ sample begin 0:0
+
+// MonotonicArenaを参照する状態を持つアロケータ。
+// コンテナの寿命はアリーナのReset()までに限られるため、コンテナは構築時のアリーナに束縛され、
+// ムーブ代入、コピー代入、swapでアロケータを伝搬しない。
+// 異なるアリーナのコンテナ間のムーブ代入は要素毎のムーブとなり、代入先のアリーナにメモリを確保する
+template <typename T>
+class ArenaAllocator {
+public:
+    using value_type                             = T;
+    using size_type                              = size_t;
+    using difference_type                        = ptrdiff_t;
+    using propagate_on_container_copy_assignment = std::false_type;
+    using propagate_on_container_move_assignment = std::false_type;
+    using propagate_on_container_swap            = std::false_type;
+    using is_always_equal                        = std::false_type;
+
+    explicit ArenaAllocator(MonotonicArena& arena) noexcept : arena_{&arena} {}
+
+    template <typename U>
+    ArenaAllocator(ArenaAllocator<U> const& rhs) noexcept : arena_{rhs.GetArena()}
+    {
+    }
+
+    T* allocate(size_type count)
+    {
+        if (count > SIZE_MAX / sizeof(T)) {  // std::allocatorと同じく、バイト数がオーバーフローする要求は送出
+            throw std::bad_array_new_length{};
+        }
+
+        if (auto mem = arena_->Allocate(count * sizeof(T), alignof(T)); mem != nullptr) {
+            return static_cast<T*>(mem);
+        }
+
+        throw MAKE_EXCEPTION(MPoolBadAlloc, "Arena : out of memory");
+    }
+
+    void deallocate(T*, size_type) noexcept {}  // Reset()でまとめて解放する
+
+    // コンテナのコピーも同じアリーナに作る
+    ArenaAllocator select_on_container_copy_construction() const noexcept { return *this; }
+
+    MonotonicArena* GetArena() const noexcept { return arena_; }
+
+private:
+    MonotonicArena* arena_;
+};
+
+template <typename T, typename U>
+bool operator==(ArenaAllocator<T> const& lhs, ArenaAllocator<U> const& rhs) noexcept
+{
+    return lhs.GetArena() == rhs.GetArena();
+}
+
+template <typename T, typename U>
+bool operator!=(ArenaAllocator<T> const& lhs, ArenaAllocator<U> const& rhs) noexcept
+{
+    return !(lhs == rhs);
+}
+// @@@ sample end
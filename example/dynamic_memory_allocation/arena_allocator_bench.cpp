@@ -0,0 +1,91 @@
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory_resource>
+#include <string>
+#include <vector>
+
+#include "gtest_wrapper.h"
+
+#include "arena_allocator.h"
+#include "dynamic_memory_allocation_ut.h"
+
+namespace {
+template <typename T>
+using arena_vector = std::vector<T, ArenaAllocator<T>>;
+using arena_string = std::basic_string<char, std::char_traits<char>, ArenaAllocator<char>>;
+
+template <typename K, typename V>
+using arena_map = std::map<K, V, std::less<K>, ArenaAllocator<std::pair<K const, V>>>;
+
+// 1リクエストで確保し、リクエストの終わりに全て破棄するような処理
+template <typename VEC, typename STR, typename MAP, typename ALLOC>
+void request(ALLOC const& alloc)
+{
+    auto vec = VEC{alloc};
+    auto str = STR{alloc};
+    auto map = MAP{alloc};
+
+    for (auto i = 0; i < 100; ++i) {
+        vec.push_back(i);
+    }
+    for (auto i = 0; i < 32; ++i) {
+        map[i] = i;
+    }
+    str.assign(200, 'a');
+}
+
+template <typename F>
+double measure(F&& f, uint32_t count)
+{
+    auto const begin = std::chrono::steady_clock::now();
+
+    for (auto i = 0U; i < count; ++i) {
+        f();
+    }
+
+    return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - begin).count() / count;
+}
+
+MonotonicArenaBuffer<16 * 1024> request_arena;
+alignas(std::max_align_t) uint8_t request_buff[16 * 1024];
+
+TEST(NewDelete_Opt, arena_allocator_benchmark)
+{
+    // @@@ sample begin 0:0
+
+    constexpr auto count = 10000U;
+
+    auto const std_alloc = measure(
+        [] {
+            request<std::vector<int>, std::string, std::map<int, int>>(std::allocator<int>{});
+        },
+        count);
+
+    auto const arena = measure(
+        [] {
+            request<arena_vector<int>, arena_string, arena_map<int, int>>(ArenaAllocator<int>{request_arena});
+            request_arena.Reset();
+        },
+        count);
+
+    auto const pmr = measure(
+        [] {
+            auto resource = std::pmr::monotonic_buffer_resource{request_buff, sizeof(request_buff),
+                                                                std::pmr::null_memory_resource()};
+            request<std::pmr::vector<int>, std::pmr::string, std::pmr::map<int, int>>(
+                std::pmr::polymorphic_allocator<int>{&resource});
+        },
+        count);
+
+    std::cout << "allocator                   [ns/request]" << std::endl;
+    std::cout << std::fixed << std::setprecision(1);
+    std::cout << "std::allocator              " << std::setw(12) << std_alloc << std::endl;
+    std::cout << "ArenaAllocator              " << std::setw(12) << arena << std::endl;
+    std::cout << "monotonic_buffer_resource   " << std::setw(12) << pmr << std::endl;
+
+    ASSERT_EQ(0, request_arena.GetUsed());
+    // @@@ sample end
+}
+}  // namespace
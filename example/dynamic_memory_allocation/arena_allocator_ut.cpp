@@ -0,0 +1,98 @@
+#include <cstdint>
+#include <map>
+#include <memory_resource>
+#include <new>
+#include <string>
+#include <vector>
+
+#include "gtest_wrapper.h"
+
+#include "arena_allocator.h"
+#include "dynamic_memory_allocation_ut.h"
+
+namespace {
+TEST(NewDelete_Opt, monotonic_arena)
+{
+    auto arena = MonotonicArenaBuffer<256>{};
+
+    auto m0 = arena.Allocate(1, 1);
+    auto m1 = arena.Allocate(8, 8);  // アラインメントのために7バイト進む
+
+    ASSERT_EQ(static_cast<uint8_t*>(m0) + 8, m1);
+    ASSERT_EQ(16, arena.GetUsed());
+
+    ASSERT_EQ(nullptr, arena.Allocate(256, 1));  // 足りない
+    ASSERT_NE(nullptr, arena.Allocate(240, 1));  // ちょうど使い切る
+    ASSERT_EQ(nullptr, arena.Allocate(1, 1));
+
+    arena.Reset();
+    ASSERT_EQ(0, arena.GetUsed());
+    ASSERT_EQ(m0, arena.Allocate(1, 1));  // 同じメモリを再利用
+}
+
+// @@@ sample begin 0:0
+
+template <typename T>
+using arena_vector = std::vector<T, ArenaAllocator<T>>;
+using arena_string = std::basic_string<char, std::char_traits<char>, ArenaAllocator<char>>;
+
+template <typename K, typename V>
+using arena_map = std::map<K, V, std::less<K>, ArenaAllocator<std::pair<K const, V>>>;
+// @@@ sample end
+
+TEST(NewDelete_Opt, arena_allocator)
+{
+    // @@@ sample begin 0:1
+
+    auto arena = MonotonicArenaBuffer<4096>{};
+
+    {
+        auto vec = arena_vector<int>{ArenaAllocator<int>{arena}};
+        auto str = arena_string{"a string longer than the small string buffer", ArenaAllocator<char>{arena}};
+        auto map = arena_map<int, int>{ArenaAllocator<std::pair<int const, int>>{arena}};
+
+        vec.push_back(1);
+        map[1] = 1;
+
+        ASSERT_GT(arena.GetUsed(), str.size());
+        ASSERT_EQ(&arena, map.get_allocator().GetArena());  // rebindしても同じアリーナ
+    }  // デストラクタはdeallocateを呼ぶが、メモリはアリーナに残る
+
+    ASSERT_NE(0, arena.GetUsed());
+
+    arena.Reset();  // 全てのコンテナのメモリをO(1)で解放
+    ASSERT_EQ(0, arena.GetUsed());
+    // @@@ sample end
+
+    auto vec = arena_vector<int>{ArenaAllocator<int>{arena}};
+    vec.resize(512);                                // 2048バイト
+    ASSERT_THROW(vec.resize(1024), MPoolBadAlloc);  // 解放されないため、4096バイトを追加で確保できない
+
+    auto alloc = ArenaAllocator<int>{arena};
+    ASSERT_THROW(alloc.allocate(SIZE_MAX / sizeof(int) + 1), std::bad_array_new_length);  // バイト数がオーバーフロー
+}
+
+TEST(NewDelete_Opt, arena_allocator_propagate)
+{
+    // @@@ sample begin 1:0
+
+    auto request0 = MonotonicArenaBuffer<1024>{};
+    auto request1 = MonotonicArenaBuffer<1024>{};
+
+    auto a = arena_vector<int>{{1, 2, 3}, ArenaAllocator<int>{request0}};
+    auto b = arena_vector<int>{ArenaAllocator<int>{request1}};
+
+    b = std::move(a);  // アロケータは伝搬しないため、bはrequest1に要素をムーブする
+    ASSERT_EQ(&request1, b.get_allocator().GetArena());
+    ASSERT_EQ(3, b.size());
+
+    auto c = b;  // コピー構築は同じアリーナ
+    ASSERT_EQ(&request1, c.get_allocator().GetArena());
+
+    a = c;  // コピー代入もアロケータは伝搬しない
+    ASSERT_EQ(&request0, a.get_allocator().GetArena());
+    ASSERT_EQ(3, a.size());
+    // @@@ sample end
+}
+
+}  // namespace
@@ -0,0 +1,82 @@
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+
+#include "gtest_wrapper.h"
+
+#include "dynamic_memory_allocation_ut.h"
+#include "mpool_fixed.h"
+#include "op_new.h"
+
+struct Particle : OpNew<Particle> {
+    explicit Particle(double v) noexcept : x{v}, y{v}, z{v} {}
+    double x;
+    double y;
+    double z;
+};
+
+constexpr uint32_t particle_max{4096};
+
+MPoolFixed<sizeof(Particle), particle_max> mpf_particle;
+
+template <>
+MPool& OpNew<Particle>::mpool_ = mpf_particle;
+
+namespace {
+struct batch_result {
+    double loop_ns;   // 1個ずつnew/deleteした場合の1個当たり
+    double batch_ns;  // NewBatch/DeleteBatchの場合の1個当たり
+};
+
+template <size_t N>
+batch_result new_delete_batch()
+{
+    using clock = std::chrono::steady_clock;
+
+    static Particle* objs[N];
+    constexpr auto   rounds = 1024 * 1024 / N;  // Nによらず総数を揃える
+
+    auto begin = clock::now();
+
+    for (auto r = 0U; r < rounds; ++r) {
+        for (auto i = 0U; i < N; ++i) {
+            objs[i] = new Particle{1.0};
+        }
+        for (auto i = 0U; i < N; ++i) {
+            delete objs[i];
+        }
+    }
+
+    auto const loop = std::chrono::duration<double, std::nano>(clock::now() - begin).count() / (rounds * N);
+
+    begin = clock::now();
+
+    for (auto r = 0U; r < rounds; ++r) {
+        OpNew<Particle>::NewBatch(objs, 1.0);
+        OpNew<Particle>::DeleteBatch(objs);
+    }
+
+    auto const batch = std::chrono::duration<double, std::nano>(clock::now() - begin).count() / (rounds * N);
+
+    return batch_result{loop, batch};
+}
+
+TEST(NewDelete_Opt, class_new_delete_batch_benchmark)
+{
+    // @@@ sample begin 0:0
+
+    auto const show = [](size_t n, batch_result r) {
+        std::cout << std::setw(5) << n << std::fixed << std::setprecision(2) << std::setw(15) << r.loop_ns
+                  << std::setw(16) << r.batch_ns << std::endl;
+    };
+
+    std::cout << "    N  new loop[ns/obj]  NewBatch[ns/obj]" << std::endl;
+
+    show(16, new_delete_batch<16>());
+    show(256, new_delete_batch<256>());
+    show(particle_max, new_delete_batch<particle_max>());
+
+    ASSERT_EQ(particle_max, mpf_particle.GetCount());
+    // @@@ sample end
+}
+}  // namespace
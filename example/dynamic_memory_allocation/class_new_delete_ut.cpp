@@ -147,6 +147,33 @@ TEST(NewDelete_Opt, class_new_delete_fixed_derived_large)
     ASSERT_THROW(auto large = std::make_unique<Large>(), MPoolBadAlloc);  // サイズが大きすぎる
     // @@@ sample end
 }
+
+TEST(NewDelete_Opt, class_new_delete_batch)
+{
+    // @@@ sample begin 2:3
+
+    ASSERT_EQ(10, mpf_ABCD.GetCount());
+
+    {
+        D* d[4];
+
+        OpNew<A>::NewBatch(d);  // 1回のロックで4個分のメモリを得て、4個のDを生成
+        ASSERT_EQ(6, mpf_ABCD.GetCount());
+
+        for (auto p : d) {
+            ASSERT_STREQ("A", p->name0);
+            ASSERT_STREQ("D", p->name2);
+        }
+
+        OpNew<A>::DeleteBatch(d);
+        ASSERT_EQ(10, mpf_ABCD.GetCount());
+    }
+
+    B* b[11];
+    ASSERT_THROW(OpNew<A>::NewBatch(b), MPoolBadAlloc);  // 10個しかない
+    ASSERT_EQ(10, mpf_ABCD.GetCount());                   // 確保できた分は返されている
+    // @@@ sample end
+}
 }  // namespace
 
 namespace Usage_OpNewDeleted {
@@ -1,5 +1,29 @@
+#pragma once
+#include <unistd.h>
+
+#include <cstddef>
+#include <cstdio>
+
 #ifdef SANITIZER  // sanitizerはnew/deleteオーバーロードのテストは誤動作する
 #define NewDelete_Opt DISABLED_NewDelete
 #else
 #define NewDelete_Opt NewDelete
 #endif
+
+// 自プロセスの常駐メモリ(RSS)のKB数。取得できなければ0
+inline size_t rss_kb()
+{
+    auto file = std::fopen("/proc/self/statm", "r");
+
+    if (file == nullptr) {
+        return 0;
+    }
+
+    auto size     = 0UL;
+    auto resident = 0UL;
+    auto n        = std::fscanf(file, "%lu %lu", &size, &resident);
+
+    std::fclose(file);
+
+    return n == 2 ? resident * (sysconf(_SC_PAGESIZE) / 1024) : 0;
+}
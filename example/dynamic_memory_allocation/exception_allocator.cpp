@@ -0,0 +1,107 @@
+#include <unwind.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <typeinfo>
+
+#include "exception_allocator.h"
+#include "suppress_warning.h"
+
+#ifndef __CYGWIN__  // この実装は、cygwinでは動作しない
+
+SUPPRESS_WARN_BEGIN;
+SUPPRESS_WARN_CLANG_DEPRECATED_DECL;
+// @@@ sample begin 0:0
+
+// https://github.com/hjl-tools/gcc/blob/master/libstdc%2B%2B-v3/libsupc%2B%2B/unwind-cxx.h
+// の抜粋
+namespace __cxxabiv1 {
+struct __cxa_exception {
+    // @@@ ignore begin
+#if defined(__LP64__) || defined(_WIN64) || defined(_LIBCXXABI_ARM_EHABI)
+    // Now _Unwind_Exception is marked with __attribute__((aligned)),
+    // which implies __cxa_exception is also aligned. Insert padding
+    // in the beginning of the struct, rather than before unwindHeader.
+    void* reserve;
+
+    // This is a new field to support C++ 0x exception_ptr.
+    // For binary compatibility it is at the start of this
+    // struct which is prepended to the object thrown in
+    // __cxa_allocate_exception.
+    size_t referenceCount;
+#endif
+
+    //  Manage the exception object itself.
+    std::type_info* exceptionType;
+    void (*exceptionDestructor)(void*);
+    std::unexpected_handler unexpectedHandler;
+    std::terminate_handler  terminateHandler;
+
+    __cxa_exception* nextException;
+
+    int handlerCount;
+
+#if defined(_LIBCXXABI_ARM_EHABI)
+    __cxa_exception* nextPropagatingException;
+    int              propagationCount;
+#else
+    int                  handlerSwitchValue;
+    unsigned char const* actionRecord;
+    unsigned char const* languageSpecificData;
+    void*                catchTemp;
+    void*                adjustedPtr;
+#endif
+
+#if !defined(__LP64__) && !defined(_WIN64) && !defined(_LIBCXXABI_ARM_EHABI)
+    // This is a new field to support C++ 0x exception_ptr.
+    // For binary compatibility it is placed where the compiler
+    // previously adding padded to 64-bit align unwindHeader.
+    size_t referenceCount;
+#endif
+    _Unwind_Exception unwindHeader;
+    // @@@ ignore end
+};
+SUPPRESS_WARN_END;
+}  // namespace __cxxabiv1
+
+namespace {
+
+constexpr size_t offset{sizeof(__cxxabiv1::__cxa_exception)};
+
+ExceptionAllocator<offset> exception_allocator;
+}  // namespace
+
+extern "C" {
+
+void* __cxa_allocate_exception(size_t thrown_size) noexcept
+{
+    auto* ret = static_cast<uint8_t*>(exception_allocator.Alloc(thrown_size));  // thrown_size + offsetを確保
+
+    if (ret == nullptr) {  // std::mallocも失敗した。処理系の実装と同じく、これ以上続けられない
+        std::terminate();
+    }
+
+    ret += offset;
+
+    return ret;
+}
+
+void __cxa_free_exception(void* thrown_exception) noexcept
+{
+    auto* ret = static_cast<uint8_t*>(thrown_exception);
+
+    ret -= offset;
+    exception_allocator.Free(ret);
+}
+// @@@ sample end
+}
+
+ExceptionMemSource ExceptionSourceOf(void const* thrown) noexcept
+{
+    return exception_allocator.GetSource(static_cast<uint8_t const*>(thrown) - offset);
+}
+
+uint32_t     ExceptionBufferCount() noexcept { return exception_allocator.GetBufferCount(); }
+MPool const& ExceptionPool(size_t index) noexcept { return exception_allocator.GetPool(index); }
+#endif
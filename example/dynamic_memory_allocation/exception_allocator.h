@@ -0,0 +1,179 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+
+#include "mpool_fixed.h"
+#include "mpool_magazine.h"
+
+// @@@ sample begin 0:0
+
+namespace Inner_ {
+
+// 1スレッドが持つエクセプションオブジェクト用のバッファ。
+// 確保は持ち主のスレッドだけが行うが、exception_ptr経由で他スレッドが解放することもあるため、usedはatomic
+template <size_t CHUNK_SIZE, uint32_t N>
+struct alignas(64) exception_buffer {
+    static_assert(N < 32);
+
+    std::atomic<uint32_t>             used{0};  // ビットiが1ならchunk[i]は使用中
+    alignas(std::max_align_t) uint8_t chunk[N][Roundup(alignof(std::max_align_t), CHUNK_SIZE)];
+};
+}  // namespace Inner_
+
+enum class ExceptionMemSource { ThreadBuffer, Pool, System, None };
+
+// __cxa_allocate_exception/__cxa_free_exceptionから使うアロケータ。
+// HEADER_SIZEは処理系がエクセプションオブジェクトの前に置くヘッダ(__cxa_exception)のサイズ。
+// 1. 小さなエクセプションは、スレッド毎のバッファからロックなしで確保する
+// 2. バッファが尽きたスレッドや大きなエクセプションは、サイズ区分毎の共有プールから確保する
+// 3. それも尽きた場合はstd::mallocで確保するため、Alloc()がassertすることはない
+template <size_t HEADER_SIZE, uint32_t BUFFER_COUNT = 4>
+class ExceptionAllocator {
+public:
+    ExceptionAllocator() noexcept                            = default;
+    ExceptionAllocator(ExceptionAllocator const&)            = delete;
+    ExceptionAllocator& operator=(ExceptionAllocator const&) = delete;
+
+    // ヘッダの先頭を返す。ヘッダのみ0クリアする。std::mallocも失敗した場合のみnullptr
+    void* Alloc(size_t thrown_size) noexcept
+    {
+        auto const size = HEADER_SIZE + thrown_size;
+        auto       mem  = alloc(size);
+
+        if (mem != nullptr) {
+            memset(mem, 0, HEADER_SIZE);  // エクセプションオブジェクト自体はコンストラクタが初期化する
+        }
+
+        return mem;
+    }
+
+    void Free(void* mem) noexcept
+    {
+        if (mem == nullptr) {
+            return;
+        }
+
+        if (is_buffer(mem)) {
+            free_buffer(mem);
+            return;
+        }
+
+        for (auto mp : pools_) {
+            if (mp->IsValid(mem)) {
+                mp->Free(mem);
+                return;
+            }
+        }
+
+        std::free(mem);
+    }
+
+    ExceptionMemSource GetSource(void const* mem) const noexcept
+    {
+        if (mem == nullptr) {
+            return ExceptionMemSource::None;
+        }
+
+        if (is_buffer(mem)) {
+            return ExceptionMemSource::ThreadBuffer;
+        }
+
+        for (auto mp : pools_) {
+            if (mp->IsValid(mem)) {
+                return ExceptionMemSource::Pool;
+            }
+        }
+
+        return ExceptionMemSource::System;
+    }
+
+    // 呼び出したスレッドのバッファの空き数
+    uint32_t GetBufferCount() const noexcept
+    {
+        auto const slot = Inner_::thread_slot();
+
+        return slot == Inner_::thread_slot_none
+                   ? 0
+                   : BUFFER_COUNT - __builtin_popcount(buffers_[slot].used.load(std::memory_order_relaxed));
+    }
+
+    MPool const& GetPool(size_t index) const noexcept { return *pools_[index]; }  // indexは0～2
+    static constexpr size_t BufferSize{HEADER_SIZE + 128};  // スレッド毎のバッファが受け付ける最大長
+
+private:
+    using buffer_t = Inner_::exception_buffer<BufferSize, BUFFER_COUNT>;
+
+    buffer_t buffers_[Inner_::thread_slot_max]{};
+
+    // サイズ区分。大きいエクセプションは稀であるため、個数を減らす
+    MPoolFixed<HEADER_SIZE + 128, 64> pool_s_{};
+    MPoolFixed<HEADER_SIZE + 512, 16> pool_m_{};
+    MPoolFixed<HEADER_SIZE + 2048, 4> pool_l_{};
+    MPool* const                      pools_[3]{&pool_s_, &pool_m_, &pool_l_};
+
+    bool is_buffer(void const* mem) const noexcept
+    {
+        return &buffers_[0] <= mem && mem < &buffers_[Inner_::thread_slot_max];
+    }
+
+    void* alloc(size_t size) noexcept
+    {
+        if (size <= BufferSize) {
+            if (auto mem = alloc_buffer(); mem != nullptr) {
+                return mem;
+            }
+        }
+
+        for (auto mp : pools_) {  // 小さい区分が尽きていれば大きい区分から確保する
+            if (size <= mp->GetMaxSize()) {
+                if (auto mem = mp->AllocNoExcept(size); mem != nullptr) {
+                    return mem;
+                }
+            }
+        }
+
+        return std::malloc(size);
+    }
+
+    void* alloc_buffer() noexcept
+    {
+        auto const slot = Inner_::thread_slot();
+
+        if (slot == Inner_::thread_slot_none) {
+            return nullptr;
+        }
+
+        auto&      buffer = buffers_[slot];
+        auto const used   = buffer.used.load(std::memory_order_relaxed);
+
+        if (used == (1U << BUFFER_COUNT) - 1) {
+            return nullptr;
+        }
+
+        // ビットを立てるのはこのスレッドだけだが、他スレッドが同時に落とすことがあるためfetch_orで立てる
+        auto const index = static_cast<uint32_t>(__builtin_ctz(~used));
+        buffer.used.fetch_or(1U << index, std::memory_order_acquire);
+
+        return buffer.chunk[index];
+    }
+
+    void free_buffer(void* mem) noexcept
+    {
+        auto const offset = static_cast<uint8_t const*>(mem) - reinterpret_cast<uint8_t const*>(&buffers_[0]);
+        auto&      buffer = buffers_[offset / sizeof(buffer_t)];
+        auto const index  = (static_cast<uint8_t const*>(mem) - buffer.chunk[0]) / sizeof(buffer.chunk[0]);
+
+        buffer.used.fetch_and(~(1U << index), std::memory_order_release);
+    }
+};
+// @@@ sample end
+
+// exception_allocator.cppで__cxa_allocate_exception/__cxa_free_exceptionを置き換えたExceptionAllocatorの状態。
+// thrownはcatchしたエクセプションオブジェクトのアドレス
+ExceptionMemSource ExceptionSourceOf(void const* thrown) noexcept;
+uint32_t           ExceptionBufferCount() noexcept;  // 呼び出したスレッドのバッファの空き数
+MPool const&       ExceptionPool(size_t index) noexcept;  // indexは0～2
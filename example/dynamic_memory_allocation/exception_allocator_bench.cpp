@@ -0,0 +1,69 @@
+#include <atomic>
+#include <chrono>
+#include <exception>
+#include <iomanip>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include "gtest_wrapper.h"
+
+#include "dynamic_memory_allocation_ut.h"
+#include "exception_allocator.h"
+
+namespace {
+// n_threadsスレッドが同時にthrow/catchを繰り返す。戻り値は全スレッドが1回ずつthrow/catchする間の経過時間[ns]
+double throw_catch_mt(uint32_t n_threads, uint32_t loops)
+{
+    auto start  = std::atomic<bool>{false};
+    auto caught = std::atomic<uint32_t>{0};
+    auto ths    = std::vector<std::thread>{};
+
+    ths.reserve(n_threads);
+
+    for (auto t = 0U; t < n_threads; ++t) {
+        ths.emplace_back([&start, &caught, loops] {
+            while (!start.load(std::memory_order_acquire)) {
+                std::this_thread::yield();
+            }
+
+            for (auto i = 0U; i < loops; ++i) {
+                try {
+                    throw std::exception{};
+                }
+                catch (std::exception const&) {
+                    caught.fetch_add(1, std::memory_order_relaxed);
+                }
+            }
+        });
+    }
+
+    auto const begin = std::chrono::steady_clock::now();
+    start.store(true, std::memory_order_release);
+
+    for (auto& th : ths) {
+        th.join();
+    }
+
+    auto const ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - begin).count();
+
+    EXPECT_EQ(n_threads * loops, caught.load());
+
+    return ns / loops;
+}
+
+TEST(NewDelete_Opt, exception_allocator_benchmark)
+{
+    // @@@ sample begin 0:0
+
+    std::cout << "threads  throw/catch[ns/round]" << std::endl;
+
+    for (auto n_threads = 1U; n_threads <= 64; n_threads *= 2) {
+        std::cout << std::setw(7) << n_threads << std::fixed << std::setprecision(1) << std::setw(23)
+                  << throw_catch_mt(n_threads, 2000) << std::endl;
+    }
+
+    ASSERT_EQ(64, ExceptionPool(0).GetCount());  // 1スレッドが同時に持つのは1個のため、共有プールは不要
+    // @@@ sample end
+}
+}  // namespace
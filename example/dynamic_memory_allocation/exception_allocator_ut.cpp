@@ -1,122 +1,99 @@
-#include <unwind.h>
-
-#include <cstring>
+#include <exception>
 
 #include "gtest_wrapper.h"
 
 #include "dynamic_memory_allocation_ut.h"
-#include "mpool_fixed.h"
-#include "suppress_warning.h"
+#include "exception_allocator.h"
+#include "utils.h"
 
 #ifndef __CYGWIN__  // この実装は、cygwinでは動作しない
 
-SUPPRESS_WARN_BEGIN;
-SUPPRESS_WARN_CLANG_DEPRECATED_DECL;
-// @@@ sample begin 0:0
-
-// https://github.com/hjl-tools/gcc/blob/master/libstdc%2B%2B-v3/libsupc%2B%2B/unwind-cxx.h
-// の抜粋
-namespace __cxxabiv1 {
-struct __cxa_exception {
-    // @@@ ignore begin
-#if defined(__LP64__) || defined(_WIN64) || defined(_LIBCXXABI_ARM_EHABI)
-    // Now _Unwind_Exception is marked with __attribute__((aligned)),
-    // which implies __cxa_exception is also aligned. Insert padding
-    // in the beginning of the struct, rather than before unwindHeader.
-    void* reserve;
-
-    // This is a new field to support C++ 0x exception_ptr.
-    // For binary compatibility it is at the start of this
-    // struct which is prepended to the object thrown in
-    // __cxa_allocate_exception.
-    size_t referenceCount;
-#endif
+namespace {
+TEST(NewDelete_Opt, exception_allocator)
+{
+    // @@@ sample begin 1:0
 
-    //  Manage the exception object itself.
-    std::type_info* exceptionType;
-    void (*exceptionDestructor)(void*);
-    std::unexpected_handler unexpectedHandler;
-    std::terminate_handler  terminateHandler;
-
-    __cxa_exception* nextException;
-
-    int handlerCount;
-
-#if defined(_LIBCXXABI_ARM_EHABI)
-    __cxa_exception* nextPropagatingException;
-    int              propagationCount;
-#else
-    int                  handlerSwitchValue;
-    unsigned char const* actionRecord;
-    unsigned char const* languageSpecificData;
-    void*                catchTemp;
-    void*                adjustedPtr;
-#endif
+    auto count             = ExceptionBufferCount();
+    auto exception_occured = false;
 
-#if !defined(__LP64__) && !defined(_WIN64) && !defined(_LIBCXXABI_ARM_EHABI)
-    // This is a new field to support C++ 0x exception_ptr.
-    // For binary compatibility it is placed where the compiler
-    // previously adding padded to 64-bit align unwindHeader.
-    size_t referenceCount;
-#endif
-    _Unwind_Exception unwindHeader;
-    // @@@ ignore end
-};
-SUPPRESS_WARN_END;
-}  // namespace __cxxabiv1
+    try {
+        throw std::exception{};
+    }
+    catch (std::exception const& e) {
+        ASSERT_EQ(count - 1, ExceptionBufferCount());  // スレッドのバッファを1個消費
+        ASSERT_EQ(ExceptionMemSource::ThreadBuffer, ExceptionSourceOf(&e));
+        exception_occured = true;
+    }
 
-namespace {
+    ASSERT_TRUE(exception_occured);
+    ASSERT_EQ(count, ExceptionBufferCount());  // 1個解放
+    // @@@ sample end
+}
 
-constexpr size_t             offset{sizeof(__cxxabiv1::__cxa_exception)};
-MPoolFixed<offset + 128, 50> mpf_exception;
-}  // namespace
+struct LargeException : std::exception {
+    uint8_t buff[1024];
+};
 
-extern "C" {
+struct HugeException : std::exception {
+    uint8_t buff[4096];
+};
 
-void* __cxa_allocate_exception(size_t thrown_size)
+TEST(NewDelete_Opt, exception_allocator_size_class)
 {
-    auto alloc_size = thrown_size + offset;  // メモリの実際の必要量はthrown_size+offset
-    auto mem        = mpf_exception.AllocNoExcept(alloc_size);
+    // @@@ sample begin 2:0
 
-    assert(mem != nullptr);
+    auto const& pool_m = ExceptionPool(1);
+    auto const& pool_l = ExceptionPool(2);
+    auto const  count  = pool_l.GetCount();
 
-    memset(mem, 0, alloc_size);
-    auto* ret = static_cast<uint8_t*>(mem);
+    try {
+        throw LargeException{};
+    }
+    catch (LargeException const& e) {
+        ASSERT_EQ(ExceptionMemSource::Pool, ExceptionSourceOf(&e));
+        ASSERT_EQ(count - 1, pool_l.GetCount());
+    }
+    ASSERT_EQ(count, pool_l.GetCount());
 
-    ret += offset;
+    try {
+        throw HugeException{};  // どの区分にも収まらない
+    }
+    catch (HugeException const& e) {
+        ASSERT_EQ(ExceptionMemSource::System, ExceptionSourceOf(&e));
+    }
+    // @@@ sample end
 
-    return ret;
+    ASSERT_EQ(16, pool_m.GetCount());
 }
 
-void __cxa_free_exception(void* thrown_exception)
+// catch節の中で再帰的にthrowし、depth個のエクセプションを同時に生存させる
+void nested_throw(uint32_t depth, ExceptionMemSource (&sources)[8])
 {
-    auto* ret = static_cast<uint8_t*>(thrown_exception);
+    try {
+        throw std::exception{};
+    }
+    catch (std::exception const& e) {
+        sources[depth] = ExceptionSourceOf(&e);
 
-    ret -= offset;
-    mpf_exception.Free(ret);
-}
-// @@@ sample end
+        if (depth + 1 < ArrayLength(sources)) {
+            nested_throw(depth + 1, sources);
+        }
+    }
 }
 
-namespace {
-TEST(NewDelete_Opt, exception_allocator)
+TEST(NewDelete_Opt, exception_allocator_nested)
 {
-    // @@@ sample begin 1:0
+    ExceptionMemSource sources[8]{};
 
-    auto count             = mpf_exception.GetCount();
-    auto exception_occured = false;
+    nested_throw(0, sources);
 
-    try {
-        throw std::exception{};
-    }
-    catch (std::exception const& e) {
-        ASSERT_EQ(count - 1, mpf_exception.GetCount());  // 1個消費
-        exception_occured = true;
+    // スレッドのバッファは4個。それを超えた分は共有プールから確保される
+    for (auto i = 0U; i < ArrayLength(sources); ++i) {
+        ASSERT_EQ(i < 4 ? ExceptionMemSource::ThreadBuffer : ExceptionMemSource::Pool, sources[i]);
     }
-
-    ASSERT_TRUE(exception_occured);
-    ASSERT_EQ(count, mpf_exception.GetCount());  // 1個解放
-    // @@@ sample end
+    ASSERT_EQ(4, ExceptionBufferCount());
+    ASSERT_EQ(64, ExceptionPool(0).GetCount());
 }
+
 }  // namespace
 #endif
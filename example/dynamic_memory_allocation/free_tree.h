@@ -0,0 +1,144 @@
+#pragma once
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+
+#include "mpool_variable.h"
+
+// @@@ sample begin 0:0
+
+namespace Inner_ {
+// free_binsと同じインターフェースを持つベストフィットの空きブロック管理。
+// 小さい空きブロックはn_units毎のリストで、大きい空きブロックは(n_units, アドレス)をキーとするAVL木で管理し、
+// n_units以上で最小の空きブロックをO(log n)で探す。木のノードは空きブロック自体に置く
+class free_tree {
+public:
+    void Insert(header_t* header) noexcept
+    {
+        assert(header->n_units > 1);  // 逆リンクとフッタのため、空きブロックは最低でも2
+
+        if (header->n_units < small_units) {
+            auto& head = small_[header->n_units];
+
+            header->next      = head;
+            prev_link(header) = nullptr;
+
+            if (head != nullptr) {
+                prev_link(head) = header;
+            }
+
+            head = header;
+            small_bitmap_ |= 1ULL << header->n_units;
+        }
+        else {
+            auto node = to_node(header);
+
+            node->header.next = nullptr;  // 使用中のタグと区別される値
+
+            root_ = avl::insert(root_, node);
+        }
+
+        set_footer(header);
+    }
+
+    void Remove(header_t* header) noexcept
+    {
+        if (header->n_units < small_units) {
+            auto const prev = prev_link(header);
+
+            if (header->next != nullptr) {
+                prev_link(header->next) = prev;
+            }
+
+            if (prev != nullptr) {
+                prev->next = header->next;
+            }
+            else if ((small_[header->n_units] = header->next) == nullptr) {
+                small_bitmap_ &= ~(1ULL << header->n_units);
+            }
+        }
+        else {
+            root_ = avl::remove(root_, to_node(header));
+        }
+    }
+
+    // n_units以上で最小の空きブロックを取り外して返す。同じ大きさの中ではアドレスの小さい方を選ぶ
+    header_t* Take(size_t n_units) noexcept
+    {
+        if (n_units < small_units) {
+            if (auto const bits = small_bitmap_ & (~0ULL << n_units); bits != 0) {
+                auto found = small_[__builtin_ctzll(bits)];
+
+                Remove(found);
+
+                return found;
+            }
+        }
+
+        auto found = avl::lower_bound(root_, n_units);
+
+        if (found == nullptr) {
+            return nullptr;
+        }
+
+        root_ = avl::remove(root_, found);
+
+        return &found->header;
+    }
+
+    header_t const* First() const noexcept { return first_small(0); }
+
+    header_t const* Next(header_t const* header) const noexcept
+    {
+        if (header->n_units < small_units) {
+            return header->next != nullptr ? header->next : first_small(header->n_units + 1);
+        }
+
+        auto const next = avl::successor(root_, to_node(header));
+
+        return next == nullptr ? nullptr : &next->header;
+    }
+
+private:
+    static constexpr size_t small_units{64};  // これ未満のn_unitsはリストで管理する
+
+    struct tree_node {
+        header_t   header;
+        tree_node* left;
+        tree_node* right;
+        size_t     height;
+    };
+
+    static_assert(sizeof(tree_node) < small_units * unit_size);
+
+public:
+    // 空きブロックの先頭で管理情報(ヘッダ、逆リンク、木のノード)が使うユニット数。
+    // 空きブロックのページをOSに返す場合でも、ここは残さなければならない
+    static constexpr size_t head_units{Roundup(unit_size, sizeof(tree_node)) / unit_size};
+
+private:
+    using avl = avl_tree<tree_node>;
+
+    header_t*  small_[small_units]{};
+    uint64_t   small_bitmap_{0};
+    tree_node* root_{nullptr};
+
+    static tree_node* to_node(header_t* header) noexcept { return reinterpret_cast<tree_node*>(header); }
+    static tree_node const* to_node(header_t const* header) noexcept
+    {
+        return reinterpret_cast<tree_node const*>(header);
+    }
+
+    header_t const* first_small(size_t n_units) const noexcept
+    {
+        if (auto const bits = n_units < small_units ? small_bitmap_ & (~0ULL << n_units) : 0; bits != 0) {
+            return small_[__builtin_ctzll(bits)];
+        }
+
+        auto const min = avl::min(root_);
+
+        return min == nullptr ? nullptr : &min->header;
+    }
+};
+}  // namespace Inner_
+// @@@ sample end
@@ -1,30 +1,228 @@
+#include <algorithm>
+#include <array>
+#include <atomic>
 #include <cassert>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
 #include <new>
+#include <type_traits>
+#include <utility>
 
 #include "dynamic_memory_allocation_ut.h"
 #include "global_new_delete.h"
+#include "heap_profiler.h"
+#include "huge_page.h"
 #include "mpool_fixed.h"
+#include "spin_lock.h"
+#include "suppress_warning.h"
 
 // @@@ sample begin 0:0
 
 namespace {
 
 constexpr size_t min_unit{MPoolFixed_MinSize};
+constexpr size_t page_size{4096};
 
-template <uint32_t N_UNITS, uint32_t MEM_COUNT>
+// サイズ区分の仕様。linear_max以下はlinear_step刻み、それを超えるとclass_maxまで2倍毎にgeometric_steps個に分ける。
+// 各プールのチャンク数は、pool_bytes / サイズをcount_min～count_maxに収めたもの。
+// class_maxを超える要求はstd::mallocで確保する
+struct size_class_spec {
+    size_t   linear_step;
+    size_t   linear_max;
+    uint32_t geometric_steps;
+    size_t   class_max;
+    size_t   pool_bytes;
+    uint32_t count_min;
+    uint32_t count_max;
+};
+
+constexpr size_class_spec spec{32, 512, 4, 4096, 256 * 1024, 64, 128};
+
+// alignof(std::max_align_t)を超えるアラインメントのnew用。チャンクをキャッシュラインに揃えるため、
+// alignas(64)のカウンタにもAVX(32)やAVX-512(64)のバッファにも使える。需要は少ないため、プールは小さくする
+constexpr size_t          aligned_unit{GlobalNewDeleteMonitor::AlignedPoolAlignment};
+constexpr size_class_spec aligned_spec{64, 256, 2, 4096, 64 * 1024, 16, 128};
+
+static_assert(spec.linear_step % min_unit == 0 && spec.linear_max % spec.linear_step == 0);
+static_assert(spec.class_max > spec.linear_max && spec.class_max % min_unit == 0);
+static_assert(aligned_spec.linear_step % aligned_unit == 0 && aligned_spec.linear_max % aligned_spec.linear_step == 0);
+
+constexpr size_t next_class_size(size_class_spec const& s, size_t size) noexcept
+{
+    if (size < s.linear_max) {
+        return size + s.linear_step;
+    }
+
+    auto pow2 = s.linear_max;  // size以下で最大の2のべき乗(linear_maxが2のべき乗であれば)
+    while (pow2 * 2 <= size) {
+        pow2 *= 2;
+    }
+
+    return Roundup(s.linear_step, size + pow2 / s.geometric_steps);
+}
+
+constexpr size_t count_classes(size_class_spec const& s) noexcept
+{
+    auto n = size_t{0};
+
+    for (auto size = s.linear_step; size <= s.class_max; size = next_class_size(s, size)) {
+        ++n;
+    }
+
+    return n;
+}
+
+// mpool_tableには通常のサイズ区分、アライン済みのサイズ区分の順に並ぶ
+constexpr size_t regular_count{count_classes(spec)};
+constexpr size_t pool_count{regular_count + count_classes(aligned_spec)};
+
+struct size_class {
+    uint32_t n_units;  // チャンクのサイズはmin_unit * n_units
+    uint32_t count;
+    uint32_t align;  // チャンクのアラインメント
+};
+
+constexpr std::array<size_class, pool_count> gen_size_classes() noexcept
+{
+    auto classes = std::array<size_class, pool_count>{};
+    auto size    = size_t{0};
+
+    for (auto i = 0U; i < pool_count; ++i) {
+        auto const  aligned = i >= regular_count;
+        auto const& s       = aligned ? aligned_spec : spec;
+
+        size = (i == 0 || i == regular_count) ? s.linear_step : next_class_size(s, size);
+
+        auto const count = std::clamp<size_t>(s.pool_bytes / size, s.count_min, s.count_max);
+        auto const align = aligned ? aligned_unit : alignof(std::max_align_t);
+
+        classes[i] = size_class{static_cast<uint32_t>(size / min_unit), static_cast<uint32_t>(count),
+                                static_cast<uint32_t>(align)};
+    }
+
+    return classes;
+}
+
+constexpr auto size_classes = gen_size_classes();
+
+// (サイズ + UNIT - 1) / UNIT -> そのサイズを確保できる、first以降で最小のサイズ区分
+template <size_t UNIT, size_t CLASS_MAX>
+constexpr std::array<uint8_t, CLASS_MAX / UNIT + 1> gen_unit2index(size_t first) noexcept
+{
+    auto table = std::array<uint8_t, CLASS_MAX / UNIT + 1>{};
+    auto index = first;
+
+    for (auto units = size_t{0}; units < table.size(); ++units) {
+        if (size_classes[index].n_units * min_unit < units * UNIT) {
+            ++index;
+        }
+        table[units] = static_cast<uint8_t>(index);
+    }
+
+    return table;
+}
+
+constexpr auto unit2index         = gen_unit2index<min_unit, spec.class_max>(0);
+constexpr auto aligned_unit2index = gen_unit2index<aligned_unit, aligned_spec.class_max>(regular_count);
+
+constexpr bool is_aligned_classes() noexcept
+{
+    for (auto i = regular_count; i < pool_count; ++i) {
+        if ((size_classes[i].n_units * min_unit) % aligned_unit != 0) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static_assert(pool_count <= 64);  // non_emptyのビット数
+static_assert(size_classes[regular_count - 1].n_units * min_unit == spec.class_max);
+static_assert(size_classes[pool_count - 1].n_units * min_unit == aligned_spec.class_max);
+static_assert(is_aligned_classes());  // チャンクの長さもアラインメントの倍数でなければ、2個目以降が揃わない
+
+constexpr bool stats_enabled{GlobalNewDeleteMonitor::StatsEnabled};
+constexpr bool huge_page_enabled{GLOBAL_NEW_DELETE_HUGE_PAGE != 0};
+constexpr bool profile_enabled{GLOBAL_NEW_DELETE_PROFILE != 0};
+
+// 他のプールの統計とキャッシュラインを共有しないようにする。
+// 統計はプールの状態の推定にしか使わないため、全てrelaxedで十分
+struct alignas(64) pool_stats_t {
+    std::atomic<uint64_t> allocs{0};
+    std::atomic<uint64_t> frees{0};
+    std::atomic<uint64_t> failures{0};
+    std::atomic<uint64_t> fallbacks{0};
+    std::atomic<uint64_t> lock_spins{0};
+    std::atomic<uint64_t> latency[GlobalNewDeleteStats::latency_buckets]{};
+};
+
+pool_stats_t pool_stats[pool_count];
+
+void count_up(std::atomic<uint64_t>& counter, uint64_t n = 1) noexcept
+{
+    if constexpr (stats_enabled) {
+        counter.fetch_add(n, std::memory_order_relaxed);
+    }
+}
+
+using pool_lock_t = SpinLock;  // プールのロック。統計の有無で変えない
+
+// pool_lock_tそのもので排他し、待たされてスピンした回数をpool_stats[INDEX]に加算する
+template <size_t INDEX>
+class PoolLockStats {
+public:
+    void lock() noexcept
+    {
+        auto spins = uint64_t{0};
+
+        lock_.lock([&spins]() noexcept { ++spins; });
+
+        if (spins != 0) {  // 競合が無ければ共有カウンタに触れない
+            count_up(pool_stats[INDEX].lock_spins, spins);
+        }
+    }
+
+    void unlock() noexcept { lock_.unlock(); }
+
+private:
+    pool_lock_t lock_{};
+};
+
+// size_classes[INDEX]のプール
+template <size_t INDEX>
+using mpool_t = MPoolFixed<min_unit * size_classes[INDEX].n_units, size_classes[INDEX].count, MPoolFixedNoCache,
+                           std::conditional_t<stats_enabled, PoolLockStats<INDEX>, pool_lock_t>,
+                           size_classes[INDEX].align>;
+
+// 全プールを1つのアリーナにページ境界で並べるため、各ページの持ち主は1つのプールに決まる
+template <size_t... Is>
+constexpr size_t arena_size(std::index_sequence<Is...>) noexcept
+{
+    return (Roundup(page_size, sizeof(mpool_t<Is>)) + ...);
+}
+
+constexpr size_t arena_bytes{arena_size(std::make_index_sequence<pool_count>{})};
+
+alignas(page_size) uint8_t arena_buff[arena_bytes];
+
+uint8_t* arena{arena_buff};       // ヒュージページを使う場合は、setup()でmmapした領域に置き換える
+uint8_t* arena_next{arena_buff};  // 次のプールの配置先
+
+template <size_t INDEX>
 [[nodiscard]] MPool* gen_mpool() noexcept
 {
-    using mp_t = MPoolFixed<min_unit * N_UNITS, MEM_COUNT>;
+    using mp_t = mpool_t<INDEX>;
 
-    static union {
-        std::max_align_t max_align;
-        uint8_t          mem[sizeof(mp_t)];
-    } mem;
+    constexpr auto mem_size = Roundup(page_size, sizeof(mp_t));
 
-    static_assert(static_cast<void*>(&mem.max_align) == static_cast<void*>(mem.mem));
-    static_assert(sizeof(mem) >= sizeof(mp_t));
+    static_assert(page_size % alignof(mp_t) == 0);
+    assert(arena_next + mem_size <= &arena[arena_bytes]);
 
-    return new (mem.mem) mp_t;  // プレースメントnew
+    auto mem = arena_next;
+    arena_next += mem_size;
+
+    return new (mem) mp_t;  // プレースメントnew
 }
 }  // namespace
 // @@@ sample end
@@ -34,71 +232,229 @@ namespace {
 // @@@ sample end
 // @@@ sample begin 1:1
 
-MPool* mpool_table[32];
+MPool* mpool_table[pool_count];
+
+// アリーナのページ -> そのページを持つプールのmpool_tableでのインデックス
+uint8_t page2index[arena_bytes / page_size];
+
+// mpool_table[i]が空でなければビットiが1。空になった時と空でなくなった時に更新する。
+// setup()の前は0であり、全プールが空として扱われる
+std::atomic<uint64_t> non_empty{0};
+static_assert(ArrayLength(mpool_table) <= 64);
 // @@@ sample end
 // @@@ sample begin 1:2
 
-// mainの前に呼ばれるため、mpool_tableを初期化するには下記のような方法が必要
-bool is_setup{false};
+template <size_t... Is>
+void gen_mpools(std::index_sequence<Is...>) noexcept
+{
+    ((mpool_table[Is] = gen_mpool<Is>()), ...);  // size_classesの順にアリーナに並ぶ
+}
 
 void setup() noexcept
 {
-    is_setup = true;
-
-    mpool_table[0] = gen_mpool<1, 128>();  //   32
-    mpool_table[1] = gen_mpool<2, 128>();  //   64
-    mpool_table[2] = gen_mpool<3, 128>();  //   96
-
-    // @@@ ignore begin
-    mpool_table[3]  = gen_mpool<4, 128>();   //  128
-    mpool_table[4]  = gen_mpool<5, 128>();   //  160
-    mpool_table[5]  = gen_mpool<6, 128>();   //  192
-    mpool_table[6]  = gen_mpool<7, 128>();   //  224
-    mpool_table[7]  = gen_mpool<8, 128>();   //  256
-    mpool_table[8]  = gen_mpool<9, 128>();   //  288
-    mpool_table[9]  = gen_mpool<10, 128>();  //  320
-    mpool_table[10] = gen_mpool<11, 128>();  //  352
-    mpool_table[11] = gen_mpool<12, 128>();  //  384
-    mpool_table[12] = gen_mpool<13, 128>();  //  416
-    mpool_table[13] = gen_mpool<14, 128>();  //  448
-    mpool_table[14] = gen_mpool<15, 128>();  //  490
-    mpool_table[15] = gen_mpool<16, 128>();  //  512
-    mpool_table[16] = gen_mpool<17, 128>();  //  544
-    mpool_table[17] = gen_mpool<18, 128>();  //  576
-    mpool_table[18] = gen_mpool<19, 128>();  //  608
-    mpool_table[19] = gen_mpool<20, 128>();  //  640
-    mpool_table[20] = gen_mpool<21, 128>();  //  672
-    mpool_table[21] = gen_mpool<22, 128>();  //  704
-    mpool_table[22] = gen_mpool<23, 128>();  //  736
-    mpool_table[23] = gen_mpool<24, 128>();  //  768
-    mpool_table[24] = gen_mpool<25, 128>();  //  800
-    mpool_table[25] = gen_mpool<26, 128>();  //  832
-    mpool_table[26] = gen_mpool<27, 128>();  //  864
-    mpool_table[27] = gen_mpool<28, 128>();  //  896
-    mpool_table[28] = gen_mpool<29, 128>();  //  928
-    // @@@ ignore end
-
-    mpool_table[29] = gen_mpool<30, 128>();  //  960
-    mpool_table[30] = gen_mpool<31, 128>();  //  992
-    mpool_table[31] = gen_mpool<32, 128>();  // 1024
-}
-
-size_t size2index(size_t v) noexcept { return (((v + (min_unit - 1)) & ~(min_unit - 1)) / min_unit) - 1; }
+    // 全プールを数個のヒュージページに収め、フリーリストを辿る際のTLBミスを減らす。この領域は解放しない
+    if constexpr (huge_page_enabled) {
+        if (auto hp = HugePageMap(arena_bytes); hp.mem != nullptr) {
+            arena      = static_cast<uint8_t*>(hp.mem);
+            arena_next = arena;
+        }
+    }
+
+    gen_mpools(std::make_index_sequence<pool_count>{});
+
+    // 各プールはmpool_tableの順にアリーナに並ぶため、次のプールの手前までがそのプールのページ
+    for (auto i = 0U; i < ArrayLength(mpool_table); ++i) {
+        auto const first = reinterpret_cast<uint8_t*>(mpool_table[i]) - arena;
+        auto const last  = i + 1 < ArrayLength(mpool_table) ? reinterpret_cast<uint8_t*>(mpool_table[i + 1]) - arena
+                                                            : arena_next - arena;
+
+        for (auto page = first / page_size; page < last / page_size; ++page) {
+            page2index[page] = i;
+        }
+    }
+
+    non_empty.store(~0ULL >> (64 - ArrayLength(mpool_table)));
+}
+
+// mainの前の静的オブジェクトの初期化からも呼ばれるため、最初のnewの前にsetup()を終えておくことはできない。
+// 定数初期化されたnon_emptyは全プールが空であることを示すので、最初のnewはプールを探さずにここへ来る。
+// 以後ここへ来るのはプールが尽きた時だけであるため、newの通常の経路にsetup済みかの判定は不要
+void setup_once() noexcept
+{
+    static bool const done = (setup(), true);  // 複数スレッドから呼ばれても1回だけ
+
+    IGNORE_UNUSED_VAR(done);
+}
+
+// サイズ区分のインデックス。class_maxを超えるサイズはregular_count
+size_t size2index(size_t v) noexcept
+{
+    auto const units = (v + (min_unit - 1)) / min_unit;
+
+    return units < unit2index.size() ? unit2index[units] : regular_count;
+}
+
+// アライン済みのサイズ区分のインデックス。aligned_spec.class_maxを超えるサイズはArrayLength(mpool_table)
+size_t aligned_size2index(size_t v) noexcept
+{
+    auto const units = (v + (aligned_unit - 1)) / aligned_unit;
+
+    return units < aligned_unit2index.size() ? aligned_unit2index[units] : ArrayLength(mpool_table);
+}
+
+// memを管理するプールのインデックス。走査も仮想関数呼び出しも行わない
+size_t addr2index(void const* mem) noexcept
+{
+    auto const offset = reinterpret_cast<uintptr_t>(mem) - reinterpret_cast<uintptr_t>(arena);
+
+    return offset < arena_bytes ? page2index[offset / page_size] : ArrayLength(mpool_table);
+}
+
+// index以上end未満で空でない最小のプールのインデックス。無ければend
+size_t next_non_empty(size_t index, size_t end) noexcept
+{
+    if (index >= end) {
+        return end;
+    }
+
+    auto const bits = non_empty.load(std::memory_order_acquire) & (~0ULL << index) & (~0ULL >> (64 - end));
+
+    return bits == 0 ? end : __builtin_ctzll(bits);
+}
+
+void mark_empty(size_t index) noexcept
+{
+    non_empty.fetch_and(~(1ULL << index));
+
+    if (mpool_table[index]->GetCount() != 0) {  // ビットを落とす直前に解放されていた
+        non_empty.fetch_or(1ULL << index);
+    }
+}
+
+void mark_non_empty(size_t index) noexcept
+{
+    if ((non_empty.load(std::memory_order_relaxed) & (1ULL << index)) == 0) {  // 空 -> 非空の時だけ書く
+        non_empty.fetch_or(1ULL << index);
+    }
+}
+
+void free_to(size_t index, void* mem) noexcept
+{
+    assert(index < ArrayLength(mpool_table));
+
+    mpool_table[index]->Free(mem);
+    mark_non_empty(index);
+    count_up(pool_stats[index].frees);
+}
+
+using clock = std::chrono::steady_clock;
+
+// 計測するnewであれば現在時刻、そうでなければclock::time_point{}
+clock::time_point latency_sample_begin() noexcept
+{
+    if constexpr (stats_enabled) {
+        thread_local uint32_t tick{0};  // スレッド毎に数えるため、共有カウンタに触れない
+
+        if (++tick % GlobalNewDeleteStats::latency_sample_rate == 0) {
+            return clock::now();
+        }
+    }
+
+    return clock::time_point{};
+}
+
+// requestedは要求されたサイズに対応するプールのインデックス
+void on_alloc(size_t index, size_t requested, clock::time_point sample) noexcept
+{
+    count_up(pool_stats[index].allocs);
+
+    if (index != requested) {
+        count_up(pool_stats[index].fallbacks);
+    }
+
+    if (sample != clock::time_point{}) {
+        auto const ns     = std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() - sample).count();
+        auto const bucket = ns <= 1 ? 0U : 63U - __builtin_clzll(static_cast<uint64_t>(ns));
+
+        count_up(pool_stats[index].latency[std::min(bucket, GlobalNewDeleteStats::latency_buckets - 1)]);
+    }
+}
+
+// class_sizeは使用したプールのメモリ長。std::mallocから確保した場合は0
+void profile_alloc(void* mem, size_t size, size_t class_size) noexcept
+{
+    if constexpr (profile_enabled) {
+        HeapProfileAlloc(mem, size, class_size);
+    }
+}
+
+void profile_free(void* mem) noexcept
+{
+    if constexpr (profile_enabled) {
+        HeapProfileFree(mem);
+    }
+}
+
+void on_failure(size_t index) noexcept { count_up(pool_stats[index].failures); }
+
+// mpool_table[index]のチャンクのサイズ。GetSize()と同じだが仮想関数を呼ばない
+size_t class_size(size_t index) noexcept { return min_unit * size_classes[index].n_units; }
+
+// mpool_table[index]～mpool_table[end - 1]から、空でない最小のプールを使って確保する。全て空ならnullptr
+void* alloc_from(size_t index, size_t end, size_t size) noexcept
+{
+    auto const sample = latency_sample_begin();
+
+    // 空のプールを飛ばし、使えるプールをビット演算1回で探す
+    for (auto i = next_non_empty(index, end); i < end; i = next_non_empty(i, end)) {
+        void* mem = mpool_table[i]->AllocNoExcept(size);
+
+        // 最後のチャンクを確保してもビットは落とさず、次の確保が失敗した時に落とす。
+        // 成功した確保の度にGetCount()を呼ぶ(仮想関数呼び出しとロックなしの読み出し)よりも安い
+        if (mem == nullptr) {
+            mark_empty(i);
+            continue;
+        }
+
+        on_alloc(i, index, sample);
+        profile_alloc(mem, size, class_size(i));
+        return mem;
+    }
+
+    setup_once();
+
+    // 最初のnewであった場合と、ビットマップの更新と競合した場合に備え、諦める前に全プールを確認する
+    for (auto i = index; i < end; ++i) {
+        void* mem = mpool_table[i]->AllocNoExcept(size);
+        if (mem != nullptr) {
+            on_alloc(i, index, sample);
+            profile_alloc(mem, size, class_size(i));
+            return mem;
+        }
+    }
+
+    on_failure(index);
+
+    return nullptr;
+}
 }  // namespace
 // @@@ sample end
 // @@@ sample begin 2:0
 
 [[nodiscard]] void* operator new(std::size_t size)
 {
-    if (!is_setup) {
-        setup();
-    }
+    auto const index = size2index(size);
 
-    for (auto i = size2index(size); i < ArrayLength(mpool_table); ++i) {
-        void* mem = mpool_table[i]->AllocNoExcept(size);
-        if (mem != nullptr) {
+    if (index == regular_count) {  // どのサイズ区分にも収まらない
+        if (auto mem = std::malloc(size); mem != nullptr) {
+            profile_alloc(mem, size, 0);
             return mem;
         }
+        throw std::bad_alloc{};
+    }
+
+    if (auto mem = alloc_from(index, regular_count, size); mem != nullptr) {
+        return mem;
     }
 
     throw std::bad_alloc{};
@@ -112,33 +468,111 @@ size_t size2index(size_t v) noexcept { return (((v + (min_unit - 1)) & ~(min_uni
 
 void operator delete(void* mem) noexcept
 {
-    for (MPool* mp : mpool_table) {
-        if (mp->IsValid(mem)) {
-            mp->Free(mem);
-            return;
-        }
+    if (mem == nullptr) {
+        return;
+    }
+
+    profile_free(mem);
+
+    if (auto const index = addr2index(mem); index < ArrayLength(mpool_table)) {
+        free_to(index, mem);
+    }
+    else {  // アリーナの外はstd::mallocで確保したもの
+        std::free(mem);
     }
-    assert(false);
 }
 // @@@ sample end
 // @@@ sample begin 4:0
 
 void operator delete(void* mem, std::size_t size) noexcept
 {
-    for (auto i = size2index(size); i < ArrayLength(mpool_table); ++i) {
-        if (mpool_table[i]->IsValid(mem)) {
-            mpool_table[i]->Free(mem);
-            return;
+    if (mem == nullptr) {
+        return;
+    }
+
+    auto const index = addr2index(mem);
+
+    assert(index >= size2index(size));
+    IGNORE_UNUSED_VAR(size);
+
+    profile_free(mem);
+
+    if (index < ArrayLength(mpool_table)) {
+        free_to(index, mem);
+    }
+    else {
+        std::free(mem);
+    }
+}
+// @@@ sample end
+// @@@ sample begin 4:1
+
+// alignof(std::max_align_t)より大きいアラインメントのnew。
+// アライン済みのプールのチャンクはaligned_unitに揃っており、それを超えるアラインメントはstd::aligned_allocで確保する
+[[nodiscard]] void* operator new(std::size_t size, std::align_val_t alignment)
+{
+    auto const align = static_cast<size_t>(alignment);
+
+    if (align <= alignof(std::max_align_t)) {
+        return ::operator new(size);
+    }
+
+    auto const index = align <= aligned_unit ? aligned_size2index(size) : ArrayLength(mpool_table);
+
+    if (index == ArrayLength(mpool_table)) {
+        if (auto mem = std::aligned_alloc(align, Roundup(align, std::max<size_t>(size, 1))); mem != nullptr) {
+            profile_alloc(mem, size, 0);
+            return mem;
         }
+        throw std::bad_alloc{};
     }
-    assert(false);
+
+    if (auto mem = alloc_from(index, ArrayLength(mpool_table), size); mem != nullptr) {
+        return mem;
+    }
+
+    throw std::bad_alloc{};
 }
+
+// どのプールのメモリか、std::malloc(std::aligned_alloc)のメモリかはアドレスからわかる
+void operator delete(void* mem, std::align_val_t) noexcept { ::operator delete(mem); }
+void operator delete(void* mem, std::size_t, std::align_val_t) noexcept { ::operator delete(mem); }
 // @@@ sample end
 // @@@ sample begin 5:0
 
 MPool const* const* GlobalNewDeleteMonitor::begin() const noexcept { return &mpool_table[0]; }
-MPool const* const* GlobalNewDeleteMonitor::end() const noexcept { return &mpool_table[ArrayLength(mpool_table)]; }
+MPool const* const* GlobalNewDeleteMonitor::end() const noexcept { return &mpool_table[regular_count]; }
 
 MPool const* const* GlobalNewDeleteMonitor::cbegin() const noexcept { return begin(); }
 MPool const* const* GlobalNewDeleteMonitor::cend() const noexcept { return end(); }
+
+MPool const* const* GlobalNewDeleteMonitor::cbegin_aligned() const noexcept { return end(); }
+MPool const* const* GlobalNewDeleteMonitor::cend_aligned() const noexcept
+{
+    return &mpool_table[ArrayLength(mpool_table)];
+}
+
+GlobalNewDeleteStats GlobalNewDeleteMonitor::GetStats(MPool const* const* it) const noexcept
+{
+    assert(begin() <= it && it < cend_aligned());
+
+    auto  stats = GlobalNewDeleteStats{};
+    auto& src   = pool_stats[it - begin()];
+
+    if constexpr (stats_enabled) {
+        stats.allocs     = src.allocs.load(std::memory_order_relaxed);
+        stats.frees      = src.frees.load(std::memory_order_relaxed);
+        stats.failures   = src.failures.load(std::memory_order_relaxed);
+        stats.fallbacks  = src.fallbacks.load(std::memory_order_relaxed);
+        stats.lock_spins = src.lock_spins.load(std::memory_order_relaxed);
+
+        for (auto i = 0U; i < GlobalNewDeleteStats::latency_buckets; ++i) {
+            stats.latency[i] = src.latency[i].load(std::memory_order_relaxed);
+        }
+    }
+
+    IGNORE_UNUSED_VAR(src);
+
+    return stats;
+}
 // @@@ sample end
@@ -1,13 +1,55 @@
 #pragma once
+#include <cstddef>
+#include <cstdint>
+
 #include "mpool.h"
 
 // @@@ sample begin 0:0
 
+// グローバルnew/deleteの統計を取らない場合は、コンパイル時に-DGLOBAL_NEW_DELETE_STATS=0とする
+#ifndef GLOBAL_NEW_DELETE_STATS
+#define GLOBAL_NEW_DELETE_STATS 1
+#endif
+
+// 全プールをヒュージページ上に置く場合は、-DGLOBAL_NEW_DELETE_HUGE_PAGE=1とする
+#ifndef GLOBAL_NEW_DELETE_HUGE_PAGE
+#define GLOBAL_NEW_DELETE_HUGE_PAGE 0
+#endif
+
+// HeapProfilerをグローバルnew/deleteに組み込まない場合は、-DGLOBAL_NEW_DELETE_PROFILE=0とする
+#ifndef GLOBAL_NEW_DELETE_PROFILE
+#define GLOBAL_NEW_DELETE_PROFILE 1
+#endif
+
+// GlobalNewDeleteMonitorが示すプール毎の統計
+struct GlobalNewDeleteStats {
+    static constexpr uint32_t latency_buckets{16};
+    static constexpr uint32_t latency_sample_rate{64};  // スレッド毎にこの回数に1回、newの所要時間を計る
+
+    uint64_t allocs;     // このプールから確保した回数
+    uint64_t frees;      // このプールに解放した回数
+    uint64_t failures;   // このプールのサイズ区分への要求がstd::bad_allocになった回数
+    uint64_t fallbacks;  // 小さいサイズ区分が空であったため、このプールから確保した回数
+    uint64_t lock_spins;  // ロック取得を待ってスピンした回数
+    uint64_t latency[latency_buckets];  // latency[i]は所要時間が2^i～2^(i+1)-1[ns]であった回数。最後は上限なし
+};
+
 class GlobalNewDeleteMonitor {
 public:
+    static constexpr bool StatsEnabled{GLOBAL_NEW_DELETE_STATS != 0};
+
+    // 通常のnewに使うプール。サイズの昇順
     MPool const* const* cbegin() const noexcept;
     MPool const* const* cend() const noexcept;
     MPool const* const* begin() const noexcept;
     MPool const* const* end() const noexcept;
+
+    // std::align_val_tを取るnewに使うプール。サイズの昇順で、チャンクはAlignedPoolAlignmentに揃う
+    static constexpr size_t AlignedPoolAlignment{64};
+    MPool const* const*     cbegin_aligned() const noexcept;
+    MPool const* const*     cend_aligned() const noexcept;
+
+    // itはbegin()～end()かcbegin_aligned()～cend_aligned()。StatsEnabledがfalseの場合、全て0を返す
+    GlobalNewDeleteStats GetStats(MPool const* const* it) const noexcept;
 };
 // @@@ sample end
@@ -0,0 +1,53 @@
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+
+#include "gtest_wrapper.h"
+
+#include "dynamic_memory_allocation_ut.h"
+#include "global_new_delete.h"
+
+namespace {
+struct alignas(64) PerCoreCounter {  // 他のコアのカウンタとキャッシュラインを共有しない
+    uint64_t count;
+};
+
+TEST(NewDelete_Opt, global_new_delete_aligned_benchmark)
+{
+    using clock = std::chrono::steady_clock;
+
+    constexpr auto n      = 64U;  // アライン済みの64バイトのプールのチャンク数以下
+    constexpr auto rounds = 16 * 1024U;
+
+    static PerCoreCounter* counters[n];
+
+    auto const measure = [](auto&& alloc, auto&& free) {
+        auto const begin = clock::now();
+
+        for (auto r = 0U; r < rounds; ++r) {
+            for (auto& c : counters) {
+                c = alloc();
+            }
+            for (auto c : counters) {
+                free(c);
+            }
+        }
+
+        return std::chrono::duration<double, std::nano>(clock::now() - begin).count() / (rounds * n);
+    };
+
+    auto const pool = measure([] { return new PerCoreCounter; }, [](PerCoreCounter* c) { delete c; });
+    auto const sys  = measure(
+        [] {
+            auto mem = std::aligned_alloc(alignof(PerCoreCounter), sizeof(PerCoreCounter));
+            return static_cast<PerCoreCounter*>(mem);
+        },
+        [](PerCoreCounter* c) { std::free(c); });
+
+    std::cout << "alignas(64) new/delete    " << std::fixed << std::setprecision(2) << std::setw(8) << pool
+              << " [ns/obj]" << std::endl;
+    std::cout << "std::aligned_alloc/free   " << std::setw(8) << sys << " [ns/obj]" << std::endl;
+}
+}  // namespace
@@ -1,7 +1,9 @@
 #include <algorithm>
+#include <cstdlib>
 #include <iomanip>
 #include <iostream>
 #include <memory>
+#include <numeric>
 
 #include "gtest_wrapper.h"
 
@@ -10,6 +12,14 @@
 #include "utils.h"
 
 namespace {
+
+// gtestは登録した全テストの名前等をプロセスの終了まで保持し、それらは小さいサイズのプールから確保される。
+// そのため、テストの数によっては32バイトのプールは最初から空であり、以下では空きのある最初のプールを使う
+MPool const* const* first_available(MPool const* const* it, MPool const* const* end) noexcept
+{
+    return std::find_if(it, end, [](auto mp) noexcept { return mp->GetCount() != 0; });
+}
+
 TEST(NewDelete_Opt, global_new_delete_32)
 {
     auto gnd = GlobalNewDeleteMonitor{};
@@ -17,13 +27,17 @@ TEST(NewDelete_Opt, global_new_delete_32)
     auto mp32 = std::find_if(gnd.cbegin(), gnd.cend(), [](auto it) noexcept { return it->GetSize() == 32; });
 
     ASSERT_NE(mp32, gnd.cend());
-    auto count = (*mp32)->GetCount();
+
+    auto mp = first_available(mp32, gnd.cend());  // 32バイトのプールが空であれば、次に空きのあるプール
+    ASSERT_NE(mp, gnd.cend());
+    auto count = (*mp)->GetCount();
 
     {
         auto i = std::make_unique<int>();
-        ASSERT_EQ(count - 1, (*mp32)->GetCount());
+        ASSERT_TRUE((*mp)->IsValid(i.get()));
+        ASSERT_EQ(count - 1, (*mp)->GetCount());
     }
-    ASSERT_EQ(count, (*mp32)->GetCount());
+    ASSERT_EQ(count, (*mp)->GetCount());
 }
 
 TEST(NewDelete_Opt, global_new_delete_64)
@@ -46,72 +60,195 @@ TEST(NewDelete_Opt, global_new_delete_empty_0)
 {
     auto gnd = GlobalNewDeleteMonitor{};
 
-    auto mp32    = std::find_if(gnd.cbegin(), gnd.cend(), [](auto it) noexcept { return it->GetSize() == 32; });
-    auto count32 = (*mp32)->GetCount();
+    auto mp_a = first_available(gnd.cbegin(), gnd.cend());  // 通常は32バイトのプール
+    ASSERT_NE(mp_a, gnd.cend());
+    auto size_a  = (*mp_a)->GetSize();
+    auto count_a = (*mp_a)->GetCount();
 
-    auto mp64    = std::find_if(gnd.cbegin(), gnd.cend(), [](auto it) noexcept { return it->GetSize() == 64; });
-    auto count64 = (*mp64)->GetCount();
+    auto mp_b = first_available(mp_a + 1, gnd.cend());  // mp_aが空の時に使われるプール
+    ASSERT_NE(mp_b, gnd.cend());
+    auto count_b = (*mp_b)->GetCount();
 
     {
-        std::unique_ptr<char> mem[1024]{};
-        auto                  fill = 0U;
+        std::unique_ptr<char[]> mem[1024]{};
+        auto                    fill = 0U;
 
         for (; fill < ArrayLength(mem); ++fill) {
-            if ((*mp32)->GetCount() == 0) {
+            if ((*mp_a)->GetCount() == 0) {
                 break;
             }
-            mem[fill] = std::make_unique<char>();
+            mem[fill] = std::make_unique<char[]>(size_a);
         }
-        ASSERT_EQ(fill, count32);
+        ASSERT_EQ(fill, count_a);
 
         {
             // newのmpoolが切り替わるはず
-            auto mem2 = std::make_unique<char>();
+            auto mem2 = std::make_unique<char[]>(size_a);
 
-            ASSERT_EQ(count64 - 1, (*mp64)->GetCount());
-            ASSERT_FALSE((*mp32)->IsValid(mem2.get()));
-            ASSERT_TRUE((*mp64)->IsValid(mem2.get()));
+            ASSERT_EQ(count_b - 1, (*mp_b)->GetCount());
+            ASSERT_FALSE((*mp_a)->IsValid(mem2.get()));
+            ASSERT_TRUE((*mp_b)->IsValid(mem2.get()));
         }
-        ASSERT_EQ(count64, (*mp64)->GetCount());  // mem2は解放されたはず
+        ASSERT_EQ(count_b, (*mp_b)->GetCount());  // mem2は解放されたはず
 
         for (auto i = 0U; i < fill; ++i) {
             mem[i].reset();
-            ASSERT_EQ(i + 1, (*mp32)->GetCount());
-            ASSERT_EQ(count64, (*mp64)->GetCount());
+            ASSERT_EQ(i + 1, (*mp_a)->GetCount());
+            ASSERT_EQ(count_b, (*mp_b)->GetCount());
         }
     }
 
-    ASSERT_EQ(count32, (*mp32)->GetCount());
+    ASSERT_EQ(count_a, (*mp_a)->GetCount());
+
+    {
+        // 空でなくなったmpoolが再び使われるはず
+        auto mem3 = std::make_unique<char[]>(size_a);
+
+        ASSERT_TRUE((*mp_a)->IsValid(mem3.get()));
+        ASSERT_EQ(count_a - 1, (*mp_a)->GetCount());
+    }
 }
 
 TEST(NewDelete_Opt, global_new_delete_empty_1)
 {
     auto gnd = GlobalNewDeleteMonitor{};
 
-    // テスト対象のグローバルnewが持っているMPoolのメモリ最大長は1024バイト
-    auto mp1024    = std::find_if(gnd.cbegin(), gnd.cend(), [](auto it) noexcept { return it->GetSize() == 1024; });
-    auto count1024 = (*mp1024)->GetCount();
+    // 最もサイズの大きいプールが空になれば、それ以上探すプールは無い
+    auto mp_max    = gnd.cend() - 1;
+    auto size_max  = (*mp_max)->GetSize();
+    auto count_max = (*mp_max)->GetCount();
 
     {
         std::unique_ptr<char[]> mem[1024]{};
         auto                    fill = 0U;
 
         for (; fill < ArrayLength(mem); ++fill) {
-            if ((*mp1024)->GetCount() == 0) {
+            if ((*mp_max)->GetCount() == 0) {
                 break;
             }
-            mem[fill] = std::make_unique<char[]>(1024);
+            mem[fill] = std::make_unique<char[]>(size_max);
         }
-        ASSERT_EQ(fill, count1024);
+        ASSERT_EQ(fill, count_max);
 
         std::unique_ptr<char[]> mem2;
-        ASSERT_THROW(mem2 = std::make_unique<char[]>(1024), std::bad_alloc);
+        ASSERT_THROW(mem2 = std::make_unique<char[]>(size_max), std::bad_alloc);
 
         for (auto i = 0U; i < fill; ++i) {
             mem[i].reset();
-            ASSERT_EQ(i + 1, (*mp1024)->GetCount());
+            ASSERT_EQ(i + 1, (*mp_max)->GetCount());
+        }
+    }
+}
+
+TEST(NewDelete_Opt, global_new_delete_size_class)
+{
+    auto gnd = GlobalNewDeleteMonitor{};
+
+    // サイズ区分は32バイト刻みで始まり、大きくなると間隔が広がる
+    ASSERT_EQ(32, (*gnd.cbegin())->GetSize());
+    for (auto it = gnd.cbegin() + 1; it != gnd.cend(); ++it) {
+        auto const step      = (*it)->GetSize() - (*(it - 1))->GetSize();
+        auto const prev_step = it == gnd.cbegin() + 1 ? step : (*(it - 1))->GetSize() - (*(it - 2))->GetSize();
+
+        ASSERT_LE(prev_step, step);
+        ASSERT_EQ(0, step % 32);
+    }
+
+    auto const pool_of = [&gnd](void const* mem) {
+        return std::find_if(gnd.cbegin(), gnd.cend(), [mem](auto mp) noexcept { return mp->IsValid(mem); });
+    };
+
+    {
+        auto mem = std::make_unique<char[]>(600);  // 600バイト以上で最小のサイズ区分
+        auto mp  = pool_of(mem.get());
+
+        ASSERT_NE(mp, gnd.cend());
+        ASSERT_LE(600, (*mp)->GetSize());
+        ASSERT_GT(600, (*(mp - 1))->GetSize());
+    }
+    {
+        auto const size_max = (*(gnd.cend() - 1))->GetSize();
+        auto       large    = std::make_unique<char[]>(size_max + 1);  // どのプールでもなく、std::mallocで確保される
+
+        ASSERT_EQ(gnd.cend(), pool_of(large.get()));
+    }
+}
+
+TEST(NewDelete_Opt, global_new_delete_arena)
+{
+    auto gnd = GlobalNewDeleteMonitor{};
+
+    // 全プールは1つのアリーナにページ境界で並ぶ
+    for (auto it = gnd.cbegin(); it != gnd.cend(); ++it) {
+        ASSERT_EQ(0, reinterpret_cast<uintptr_t>(*it) % 4096);
+
+        if (it != gnd.cbegin()) {
+            ASSERT_LT(*(it - 1), *it);
+        }
+    }
+
+    auto mem = std::make_unique<char[]>(100);  // 128バイトのプールが使われる
+    auto mp  = std::find_if(gnd.cbegin(), gnd.cend(), [&mem](auto it) noexcept { return it->IsValid(mem.get()); });
+
+    ASSERT_NE(mp, gnd.cend());
+    ASSERT_EQ(128, (*mp)->GetSize());
+
+    auto const count = (*mp)->GetCount();
+    mem.reset();  // アドレスからプールを引き当てて解放
+    ASSERT_EQ(count + 1, (*mp)->GetCount());
+}
+
+TEST(NewDelete_Opt, global_new_delete_stats)
+{
+    if constexpr (!GlobalNewDeleteMonitor::StatsEnabled) {
+        return;
+    }
+
+    auto gnd = GlobalNewDeleteMonitor{};
+
+    auto mp_a = first_available(gnd.cbegin(), gnd.cend());
+    auto mp_b = first_available(mp_a + 1, gnd.cend());
+    ASSERT_NE(mp_b, gnd.cend());
+
+    auto const size_a  = (*mp_a)->GetSize();
+    auto const stats_a = gnd.GetStats(mp_a);
+    auto const stats_b = gnd.GetStats(mp_b);
+
+    {
+        std::unique_ptr<char[]> mem[1024]{};
+        auto                    fill = 0U;
+
+        for (; (*mp_a)->GetCount() != 0; ++fill) {
+            mem[fill] = std::make_unique<char[]>(size_a);
+        }
+        mem[fill] = std::make_unique<char[]>(size_a);  // mp_aは空のため、mp_bから確保される
+
+        ASSERT_EQ(stats_a.allocs + fill, gnd.GetStats(mp_a).allocs);
+        ASSERT_EQ(stats_b.allocs + 1, gnd.GetStats(mp_b).allocs);
+        ASSERT_EQ(stats_b.fallbacks + 1, gnd.GetStats(mp_b).fallbacks);
+        ASSERT_EQ(stats_a.fallbacks, gnd.GetStats(mp_a).fallbacks);
+    }
+
+    ASSERT_EQ(gnd.GetStats(mp_a).allocs - stats_a.allocs, gnd.GetStats(mp_a).frees - stats_a.frees);
+    ASSERT_EQ(stats_b.frees + 1, gnd.GetStats(mp_b).frees);
+
+    // 計測はスレッド毎に一定回数に1回のため、その回数newすれば少なくとも1回は計測される
+    // 32バイトのプールが空になれば他のプールから確保されるため、全プールの合計を見る
+    auto const sampled = [&gnd] {
+        auto sum = uint64_t{0};
+        for (auto it = gnd.cbegin(); it != gnd.cend(); ++it) {
+            auto const stats = gnd.GetStats(it);
+            sum = std::accumulate(std::begin(stats.latency), std::end(stats.latency), sum);
         }
+        return sum;
+    };
+    auto const sampled_before = sampled();
+
+    std::unique_ptr<char> mem[GlobalNewDeleteStats::latency_sample_rate]{};
+    for (auto& m : mem) {
+        m = std::make_unique<char>();
     }
+    ASSERT_LT(sampled_before, sampled());
 }
 
 TEST(NewDelete_Opt, global_new_delete_show)
@@ -120,13 +257,90 @@ TEST(NewDelete_Opt, global_new_delete_show)
 
     auto gm = GlobalNewDeleteMonitor{};
 
-    std::cout << "  size current   min" << std::endl;
-    std::cout << "  ------------------" << std::endl;
+    std::cout << "  size current   min   allocs fallbacks failures spins  p50[ns]" << std::endl;
+    std::cout << "  -------------------------------------------------------------" << std::endl;
+
+    for (auto it = gm.cbegin(); it != gm.cend(); ++it) {
+        auto const stats = gm.GetStats(it);
+
+        // サンプリングした所要時間の中央値が属する区分の下限
+        auto sampled = std::accumulate(std::begin(stats.latency), std::end(stats.latency), uint64_t{0});
+        auto p50     = 0U;
+        for (auto acc = uint64_t{0}; p50 < GlobalNewDeleteStats::latency_buckets; ++p50) {
+            if ((acc += stats.latency[p50]) * 2 >= sampled) {
+                break;
+            }
+        }
+
+        std::cout << std::setw(6) << (*it)->GetSize() << std::setw(8) << (*it)->GetCount() << std::setw(6)
+                  << (*it)->GetCountMin() << std::setw(9) << stats.allocs << std::setw(10) << stats.fallbacks
+                  << std::setw(9) << stats.failures << std::setw(6) << stats.lock_spins << std::setw(9)
+                  << (sampled == 0 ? 0 : 1U << p50) << std::endl;
+    }
+    // @@@ sample end
+}
+
+// @@@ sample begin 1:0
+
+struct alignas(64) PerCoreCounter {  // 他のコアのカウンタとキャッシュラインを共有しない
+    uint64_t count;
+};
+
+struct alignas(32) AvxBuffer {  // AVXのロード/ストアのため32バイトに揃える
+    float data[8 * 10];
+};
+// @@@ sample end
+
+TEST(NewDelete_Opt, global_new_delete_aligned)
+{
+    auto gnd = GlobalNewDeleteMonitor{};
+
+    auto const pool_of = [&gnd](void const* mem) {
+        return std::find_if(gnd.cbegin_aligned(), gnd.cend_aligned(),
+                            [mem](auto mp) noexcept { return mp->IsValid(mem); });
+    };
+
+    ASSERT_EQ(gnd.cend(), gnd.cbegin_aligned());
+    for (auto it = gnd.cbegin_aligned(); it != gnd.cend_aligned(); ++it) {
+        ASSERT_EQ(0, (*it)->GetSize() % GlobalNewDeleteMonitor::AlignedPoolAlignment);
+    }
+
+    // @@@ sample begin 1:1
 
-    for (MPool const* mp : gm) {
-        std::cout << std::setw(6) << mp->GetSize() << std::setw(8) << mp->GetCount() << std::setw(6)
-                  << mp->GetCountMin() << std::endl;
+    {
+        auto counter = std::make_unique<PerCoreCounter>();  // operator new(size_t, std::align_val_t)
+        auto mp      = pool_of(counter.get());
+
+        ASSERT_EQ(0, reinterpret_cast<uintptr_t>(counter.get()) % 64);
+        ASSERT_NE(gnd.cend_aligned(), mp);
+        ASSERT_EQ(64, (*mp)->GetSize());
+
+        auto const count = (*mp)->GetCount();
+        counter.reset();  // operator delete(void*, size_t, std::align_val_t)
+        ASSERT_EQ(count + 1, (*mp)->GetCount());
+    }
+    {
+        auto buffers = std::make_unique<AvxBuffer[]>(2);  // 配列もアライン済みのプールから確保される
+        auto mp      = pool_of(buffers.get());
+
+        ASSERT_EQ(0, reinterpret_cast<uintptr_t>(&buffers[1]) % 32);
+        ASSERT_NE(gnd.cend_aligned(), mp);
+        ASSERT_LE(sizeof(AvxBuffer) * 2, (*mp)->GetSize());
     }
     // @@@ sample end
+    {
+        struct alignas(128) Wide {
+            uint8_t data[128];
+        };
+
+        auto wide = std::make_unique<Wide>();  // AlignedPoolAlignmentを超えるため、std::aligned_allocで確保される
+
+        ASSERT_EQ(0, reinterpret_cast<uintptr_t>(wide.get()) % 128);
+        ASSERT_EQ(gnd.cend_aligned(), pool_of(wide.get()));
+        ASSERT_EQ(gnd.cend(), std::find_if(gnd.cbegin(), gnd.cend(), [&wide](auto mp) noexcept {
+                      return mp->IsValid(wide.get());
+                  }));
+    }
 }
+
 }  // namespace
@@ -0,0 +1,325 @@
+#include <cxxabi.h>
+#include <dlfcn.h>
+#include <unwind.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <new>
+#include <ostream>
+
+#include "heap_profiler.h"
+#include "spin_lock.h"
+#include "utils.h"
+
+// @@@ sample begin 0:0
+
+namespace {
+
+constexpr uint32_t max_samples{1024};
+constexpr uint32_t max_depth{32};
+constexpr int64_t  recheck_bytes{1024 * 1024};  // サンプリング停止中に、再開されていないか確認する間隔
+
+constexpr uint32_t max_skip{8};  // operator newのフレームを探す範囲
+
+struct sample_t {
+    void*    mem;
+    size_t   size;        // newの引数
+    size_t   class_size;  // 使用したプールのメモリ長。0はプール以外
+    size_t   interval;    // サンプリングした時の平均間隔。推定はこの値で行う
+    uint32_t depth;
+    void*    frames[max_depth];  // [0]がnewの直接の呼び出し元
+};
+
+std::atomic<size_t>   interval{0};
+std::atomic<uint64_t> dropped{0};
+
+SpinLock lock;  // samplesを保護する。この中ではnewしない
+sample_t samples[max_samples];
+uint32_t n_samples{0};
+
+SpinLock dump_lock;  // snapshotを保護する
+sample_t snapshot[max_samples];
+
+// 平均meanの指数分布。サンプリングの間隔を一定にすると、周期的なnewのパターンと同期してしまう
+int64_t next_interval(size_t mean) noexcept
+{
+    thread_local uint64_t x{reinterpret_cast<uintptr_t>(&x) | 1};  // xorshift64
+
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+
+    auto const u = (static_cast<double>(x >> 11) + 1) / 9007199254740992.0;  // (0, 1]
+
+    return std::max<int64_t>(1, static_cast<int64_t>(-std::log(u) * static_cast<double>(mean)));
+}
+
+struct backtrace_arg {
+    void*    frames[max_skip + max_depth];
+    uint32_t depth;
+};
+
+_Unwind_Reason_Code collect_frame(_Unwind_Context* context, void* arg) noexcept
+{
+    auto& bt = *static_cast<backtrace_arg*>(arg);
+    auto  ip = _Unwind_GetIP(context);
+
+    if (ip == 0) {
+        return _URC_END_OF_STACK;
+    }
+
+    bt.frames[bt.depth++] = reinterpret_cast<void*>(ip);
+
+    return bt.depth == ArrayLength(bt.frames) ? _URC_END_OF_STACK : _URC_NO_REASON;
+}
+
+// 呼び出し元のスタックをsampleに記録する。
+// インライン展開の有無でプロファイラ内部のフレーム数は変わるため、operator new(new[])のフレームを探し、
+// その外側だけを残す
+void capture_stack(sample_t& sample) noexcept
+{
+    auto bt = backtrace_arg{{}, 0};
+
+    _Unwind_Backtrace(collect_frame, &bt);
+
+    using new_t         = void* (*)(size_t);
+    using aligned_new_t = void* (*)(size_t, std::align_val_t);
+
+    void* const news[]{reinterpret_cast<void*>(static_cast<new_t>(&::operator new)),
+                       reinterpret_cast<void*>(static_cast<new_t>(&::operator new[])),
+                       reinterpret_cast<void*>(static_cast<aligned_new_t>(&::operator new)),
+                       reinterpret_cast<void*>(static_cast<aligned_new_t>(&::operator new[]))};
+
+    auto first = uint32_t{1};  // 見つからなければ、自身のフレームだけを除く
+
+    for (auto i = 0U; i < std::min(bt.depth, max_skip); ++i) {
+        auto const func = _Unwind_FindEnclosingFunction(bt.frames[i]);
+
+        if (std::find(std::begin(news), std::end(news), func) != std::end(news)) {
+            first = i + 1;
+        }
+    }
+
+    sample.depth = std::min(bt.depth - std::min(first, bt.depth), max_depth);
+    std::copy(&bt.frames[first], &bt.frames[first + sample.depth], &sample.frames[0]);
+}
+
+// 同じスタック、同じサイズ区分が隣り合うように並べる
+bool less_stack(sample_t const& lhs, sample_t const& rhs) noexcept
+{
+    if (lhs.depth != rhs.depth) {
+        return lhs.depth < rhs.depth;
+    }
+
+    auto const cmp = memcmp(lhs.frames, rhs.frames, sizeof(lhs.frames[0]) * lhs.depth);
+
+    return cmp != 0 ? cmp < 0 : lhs.class_size < rhs.class_size;
+}
+
+bool same_stack(sample_t const& lhs, sample_t const& rhs) noexcept
+{
+    return lhs.depth == rhs.depth && memcmp(lhs.frames, rhs.frames, sizeof(lhs.frames[0]) * lhs.depth) == 0;
+}
+
+// samplesをsnapshotに写して並べる。戻り値は個数。dump_lockを保持して呼ぶ
+uint32_t take_snapshot() noexcept
+{
+    auto n = uint32_t{0};
+    {
+        auto lg = std::lock_guard{lock};
+
+        n = n_samples;
+        std::copy(&samples[0], &samples[n], &snapshot[0]);
+    }
+
+    std::sort(&snapshot[0], &snapshot[n], less_stack);
+
+    return n;
+}
+
+// 1個のサンプルが表すバイト数の推定値
+double unsampled_bytes(size_t size, size_t mean) noexcept
+{
+    return size == 0 ? 0 : size / (1 - std::exp(-static_cast<double>(size) / mean));
+}
+
+void write_frame(std::ostream& os, void* frame)
+{
+    auto info = Dl_info{};
+
+    if (dladdr(frame, &info) != 0 && info.dli_sname != nullptr) {
+        auto status    = 0;
+        auto demangled = abi::__cxa_demangle(info.dli_sname, nullptr, nullptr, &status);  // mallocで確保される
+
+        os << (status == 0 ? demangled : info.dli_sname);
+        std::free(demangled);
+    }
+    else if (info.dli_fname != nullptr) {  // 静的関数等。addr2lineで引けるよう、モジュール内のオフセットにする
+        auto const name = strrchr(info.dli_fname, '/');
+
+        os << (name == nullptr ? info.dli_fname : name + 1) << "+0x" << std::hex
+           << (static_cast<uint8_t*>(frame) - static_cast<uint8_t*>(info.dli_fbase)) << std::dec;
+    }
+    else {
+        os << frame;
+    }
+}
+}  // namespace
+
+namespace Inner_ {
+
+__attribute__((noinline)) void heap_profile_sample(void* mem, size_t size, size_t class_size) noexcept
+{
+    thread_local bool in_sample{false};  // 以下でnewが呼ばれても再帰しない
+
+    auto const mean = interval.load(std::memory_order_relaxed);
+
+    if (mean == 0) {
+        heap_profile_countdown = recheck_bytes;
+        return;
+    }
+
+    heap_profile_countdown = next_interval(mean);
+
+    if (mem == nullptr || in_sample) {
+        return;
+    }
+
+    in_sample = true;
+
+    auto sample = sample_t{mem, size, class_size, mean, 0, {}};
+    capture_stack(sample);
+
+    {
+        auto  lg     = std::lock_guard{lock};
+        auto& filter = heap_profile_filter[heap_profile_hash(mem)];
+
+        if (n_samples == max_samples || filter.load(std::memory_order_relaxed) == UINT8_MAX) {
+            dropped.fetch_add(1, std::memory_order_relaxed);
+        }
+        else {
+            samples[n_samples++] = sample;
+            filter.fetch_add(1, std::memory_order_relaxed);
+            heap_profile_live.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    in_sample = false;
+}
+
+void heap_profile_free(void* mem) noexcept
+{
+    auto lg = std::lock_guard{lock};
+
+    auto const end = &samples[n_samples];
+    auto const it  = std::find_if(&samples[0], end, [mem](auto const& s) noexcept { return s.mem == mem; });
+
+    if (it == end) {  // ハッシュが衝突しただけ
+        return;
+    }
+
+    *it = samples[--n_samples];
+    heap_profile_filter[heap_profile_hash(mem)].fetch_sub(1, std::memory_order_relaxed);
+    heap_profile_live.fetch_sub(1, std::memory_order_relaxed);
+}
+}  // namespace Inner_
+// @@@ sample end
+// @@@ sample begin 1:0
+
+void HeapProfiler::SetSampleInterval(size_t bytes) noexcept
+{
+    interval.store(bytes, std::memory_order_relaxed);
+
+    // 他のスレッドは次にカウンタが0未満になった時(最長でもrecheck_bytes後)に反映する
+    Inner_::heap_profile_countdown = bytes == 0 ? recheck_bytes : next_interval(bytes);
+}
+
+size_t HeapProfiler::GetSampleInterval() noexcept { return interval.load(std::memory_order_relaxed); }
+size_t HeapProfiler::GetLiveSampleCount() noexcept { return Inner_::heap_profile_live.load(); }
+size_t HeapProfiler::GetDroppedCount() noexcept { return dropped.load(); }
+
+void HeapProfiler::DumpFolded(std::ostream& os)
+{
+    auto       lg = std::lock_guard{dump_lock};
+    auto const n  = take_snapshot();
+
+    for (auto i = 0U; i < n;) {
+        auto bytes = 0.0;
+        auto j     = i;
+
+        for (; j < n && same_stack(snapshot[i], snapshot[j]) && snapshot[i].class_size == snapshot[j].class_size;
+             ++j) {
+            bytes += unsampled_bytes(snapshot[j].size, snapshot[j].interval);
+        }
+
+        for (auto d = snapshot[i].depth; d > 0; --d) {  // 根元から
+            write_frame(os, snapshot[i].frames[d - 1]);
+            os << ';';
+        }
+
+        if (snapshot[i].class_size == 0) {
+            os << "malloc";
+        }
+        else {
+            os << "size_" << snapshot[i].class_size;
+        }
+        os << ' ' << static_cast<uint64_t>(bytes) << '\n';
+
+        i = j;
+    }
+}
+
+void HeapProfiler::DumpPprof(std::ostream& os)
+{
+    auto       lg = std::lock_guard{dump_lock};
+    auto const n  = take_snapshot();
+
+    // heap_v2ではサンプルそのままの個数とバイト数を書き、推定はpprofが行う。
+    // 解放済みの確保は記録しないため、[]内の累積値も生存中の値とする。
+    // 書く間隔は現在の値ではなくサンプリングした時の値。heap_v2は1つしか持てないため、
+    // 途中で間隔を変えた場合は最大の値とする
+    auto total    = size_t{0};
+    auto sampling = size_t{1};
+    for (auto i = 0U; i < n; ++i) {
+        total += snapshot[i].size;
+        sampling = std::max(sampling, snapshot[i].interval);
+    }
+
+    os << "heap profile: " << n << ": " << total << " [" << n << ": " << total << "] @ heap_v2/" << sampling
+       << '\n';
+
+    for (auto i = 0U; i < n;) {
+        auto bytes = size_t{0};
+        auto j     = i;
+
+        for (; j < n && same_stack(snapshot[i], snapshot[j]); ++j) {
+            bytes += snapshot[j].size;
+        }
+
+        os << j - i << ": " << bytes << " [" << j - i << ": " << bytes << "] @";
+        for (auto d = 0U; d < snapshot[i].depth; ++d) {
+            os << ' ' << snapshot[i].frames[d];
+        }
+        os << '\n';
+
+        i = j;
+    }
+
+    // pprofがアドレスをシンボルに変換するために使う
+    os << "\nMAPPED_LIBRARIES:\n";
+
+    if (auto maps = fopen("/proc/self/maps", "r"); maps != nullptr) {
+        char line[512];
+
+        while (fgets(line, sizeof(line), maps) != nullptr) {
+            os << line;
+        }
+
+        fclose(maps);
+    }
+}
+// @@@ sample end
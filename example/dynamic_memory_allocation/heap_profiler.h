@@ -0,0 +1,62 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+
+// @@@ sample begin 0:0
+
+// グローバルnewから平均SetSampleInterval()バイト毎に1回、その呼び出し元のスタックを記録し、
+// 生存中のサンプルをfolded形式(flamegraph.pl用)かpprofのレガシー形式(heap_v2)で出力する。
+// サンプリングしない間のnewのコストはスレッド毎のカウンタの減算1回、deleteのコストはアトミック変数の読み出し1回
+class HeapProfiler {
+public:
+    static void   SetSampleInterval(size_t bytes) noexcept;  // 0でサンプリングを止める(デフォルト)
+    static size_t GetSampleInterval() noexcept;
+    static size_t GetLiveSampleCount() noexcept;  // 生存中のサンプル数
+    static size_t GetDroppedCount() noexcept;     // 記録領域が尽きて捨てたサンプル数
+
+    // 1行が「呼び出し元;...;newの直接の呼び出し元;サイズ区分 推定バイト数」
+    static void DumpFolded(std::ostream& os);
+
+    // pprof --text <実行ファイル> <出力>で読める
+    static void DumpPprof(std::ostream& os);
+};
+// @@@ sample end
+// @@@ sample begin 1:0
+
+namespace Inner_ {
+constexpr size_t heap_profile_filter_size{16 * 1024};
+
+inline thread_local int64_t heap_profile_countdown{0};  // 0未満になったらサンプリングする
+
+// サンプリング中のアドレスのハッシュ毎の個数。0であればそのアドレスはサンプリングされていない
+inline std::atomic<uint8_t>  heap_profile_filter[heap_profile_filter_size]{};
+inline std::atomic<uint32_t> heap_profile_live{0};
+
+inline size_t heap_profile_hash(void const* mem) noexcept
+{
+    return (reinterpret_cast<uintptr_t>(mem) >> 4) % heap_profile_filter_size;
+}
+
+void heap_profile_sample(void* mem, size_t size, size_t class_size) noexcept;
+void heap_profile_free(void* mem) noexcept;
+}  // namespace Inner_
+
+// operator newから呼ぶ。class_sizeは使用したプールのメモリ長。プール以外から確保した場合は0
+inline void HeapProfileAlloc(void* mem, size_t size, size_t class_size) noexcept
+{
+    if ((Inner_::heap_profile_countdown -= static_cast<int64_t>(size)) < 0) {
+        Inner_::heap_profile_sample(mem, size, class_size);
+    }
+}
+
+// operator deleteから、memを解放する前に呼ぶ
+inline void HeapProfileFree(void* mem) noexcept
+{
+    if (Inner_::heap_profile_live.load(std::memory_order_relaxed) != 0
+        && Inner_::heap_profile_filter[Inner_::heap_profile_hash(mem)].load(std::memory_order_relaxed) != 0) {
+        Inner_::heap_profile_free(mem);
+    }
+}
+// @@@ sample end
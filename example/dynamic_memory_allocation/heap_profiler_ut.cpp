@@ -0,0 +1,75 @@
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "gtest_wrapper.h"
+
+#include "dynamic_memory_allocation_ut.h"
+#include "global_new_delete.h"
+#include "heap_profiler.h"
+
+#if GLOBAL_NEW_DELETE_PROFILE != 0
+
+namespace {
+
+// 10回のnewが同じスタックとして集計されるよう、インライン展開させない
+__attribute__((noinline)) std::unique_ptr<char[]> leaky_alloc() { return std::make_unique<char[]>(200); }
+
+TEST(NewDelete_Opt, heap_profiler)
+{
+    auto live = std::vector<std::unique_ptr<char[]>>{};
+    live.reserve(10);  // 以下でvectorの再確保がサンプリングされないように
+
+    // @@@ sample begin 0:0
+
+    HeapProfiler::SetSampleInterval(1);  // 全てのnewをサンプリングする
+
+    auto const before = HeapProfiler::GetLiveSampleCount();
+
+    for (auto i = 0; i < 10; ++i) {
+        live.emplace_back(leaky_alloc());
+    }
+
+    ASSERT_LE(before + 10, HeapProfiler::GetLiveSampleCount());
+
+    auto folded = std::ostringstream{};
+    HeapProfiler::DumpFolded(folded);
+
+    // 200バイトのnewは224バイトのプールから確保される。間隔1バイトでは推定値はサンプルの合計と等しい
+    ASSERT_NE(std::string::npos, folded.str().find(";size_224 2000\n"));
+
+    auto pprof = std::ostringstream{};
+    HeapProfiler::DumpPprof(pprof);
+
+    ASSERT_EQ(0, pprof.str().find("heap profile: "));
+    ASSERT_NE(std::string::npos, pprof.str().find("@ heap_v2/1\n"));
+    ASSERT_NE(std::string::npos, pprof.str().find("MAPPED_LIBRARIES:"));
+
+    HeapProfiler::SetSampleInterval(0);  // サンプリングを止めても、解放は記録から外れる
+
+    auto const sampled = HeapProfiler::GetLiveSampleCount();
+    live.clear();
+
+    ASSERT_EQ(sampled - 10, HeapProfiler::GetLiveSampleCount());
+    // @@@ sample end
+
+    // 推定と出力する間隔は、現在の値ではなくサンプリングした時の値による
+    HeapProfiler::SetSampleInterval(2);
+    for (auto i = 0; i < 10; ++i) {
+        live.emplace_back(leaky_alloc());
+    }
+    HeapProfiler::SetSampleInterval(0);
+
+    folded.str("");
+    HeapProfiler::DumpFolded(folded);
+    ASSERT_NE(std::string::npos, folded.str().find(";size_224 2000\n"));
+
+    pprof.str("");
+    HeapProfiler::DumpPprof(pprof);
+    ASSERT_NE(std::string::npos, pprof.str().find("@ heap_v2/2\n"));
+
+    live.clear();
+}
+}  // namespace
+#endif
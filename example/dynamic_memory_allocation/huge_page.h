@@ -0,0 +1,94 @@
+#pragma once
+#include <sys/mman.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+
+#include "utils.h"
+
+// @@@ sample begin 0:0
+
+constexpr size_t HugePageSize{2 * 1024 * 1024};
+
+enum class HugePageKind {
+    HugeTLB,  // MAP_HUGETLBで予約済みのヒュージページを得た
+    THP,      // 予約済みのヒュージページが無いため、madvise(MADV_HUGEPAGE)でカーネルに要求した
+    None,     // 通常のページ
+};
+
+struct HugePageMem {
+    void*        mem;
+    size_t       size;
+    HugePageKind kind;
+};
+
+// sizeをヒュージページの倍数に切り上げてmmapする。失敗時のmemはnullptr
+inline HugePageMem HugePageMap(size_t size) noexcept
+{
+    auto const bytes = Roundup(HugePageSize, size);
+
+    if (auto mem = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        mem != MAP_FAILED) {
+        return HugePageMem{mem, bytes, HugePageKind::HugeTLB};
+    }
+
+    // THPはヒュージページ境界に揃った範囲にしか適用されないため、余分に確保して前後を返す
+    auto const raw = mmap(nullptr, bytes + HugePageSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+    if (raw == MAP_FAILED) {
+        return HugePageMem{nullptr, 0, HugePageKind::None};
+    }
+
+    auto const raw_addr = reinterpret_cast<uintptr_t>(raw);
+    auto const addr     = Roundup(HugePageSize, raw_addr);
+    auto const mem      = reinterpret_cast<void*>(addr);
+
+    if (addr != raw_addr) {
+        munmap(raw, addr - raw_addr);
+    }
+    munmap(reinterpret_cast<void*>(addr + bytes), raw_addr + HugePageSize - addr);
+
+    auto const kind = madvise(mem, bytes, MADV_HUGEPAGE) == 0 ? HugePageKind::THP : HugePageKind::None;
+
+    return HugePageMem{mem, bytes, kind};
+}
+
+inline void HugePageUnmap(HugePageMem const& hp) noexcept
+{
+    if (hp.mem != nullptr) {
+        munmap(hp.mem, hp.size);
+    }
+}
+// @@@ sample end
+// @@@ sample begin 1:0
+
+// MPoolFixedやMPoolVariable等のMPOOLを、そのストレージごとヒュージページ上に構築する。
+// フリーリストを辿る際のTLBミスを減らす
+template <typename MPOOL>
+class HugePageMPool {
+public:
+    HugePageMPool() noexcept
+        : mem_{HugePageMap(sizeof(MPOOL))}, mpool_{mem_.mem == nullptr ? nullptr : new (mem_.mem) MPOOL}
+    {
+    }
+
+    ~HugePageMPool()
+    {
+        if (mpool_ != nullptr) {
+            mpool_->~MPOOL();
+            HugePageUnmap(mem_);
+        }
+    }
+
+    HugePageMPool(HugePageMPool const&)            = delete;
+    HugePageMPool& operator=(HugePageMPool const&) = delete;
+
+    MPOOL*       Get() noexcept { return mpool_; }  // mmapに失敗した場合nullptr
+    HugePageKind GetKind() const noexcept { return mem_.kind; }
+
+private:
+    HugePageMem const mem_;
+    MPOOL* const      mpool_;
+};
+// @@@ sample end
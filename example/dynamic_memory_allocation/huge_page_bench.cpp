@@ -0,0 +1,170 @@
+#include <sys/mman.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <new>
+#include <random>
+
+#include "gtest_wrapper.h"
+
+#include "dynamic_memory_allocation_ut.h"
+#include "huge_page.h"
+#include "mpool_fixed.h"
+#include "utils.h"
+
+namespace {
+char const* to_str(HugePageKind kind) noexcept
+{
+    switch (kind) {
+    case HugePageKind::HugeTLB:
+        return "HugeTLB";
+    case HugePageKind::THP:
+        return "THP";
+    case HugePageKind::None:
+        return "None";
+    }
+
+    return "";
+}
+
+struct node {
+    node*    next;
+    uint64_t value;
+};
+
+// nodeは16バイトだが、チャンクはMPoolFixed_MinSizeの32バイトになる。32バイト x 256K = 8MBで、ヒュージページ4枚分
+constexpr uint32_t bench_count{256 * 1024};
+
+using bench_mpool = MPoolFixed<sizeof(node), bench_count>;
+static_assert(sizeof(bench_mpool) >= 4 * HugePageSize);
+
+// 比較用に、ヒュージページを使わないことを明示した領域にMPOOLを置く
+template <typename MPOOL>
+class SmallPageMPool {
+public:
+    SmallPageMPool() noexcept
+        : size_{Roundup(4096, sizeof(MPOOL))},
+          mem_{mmap(nullptr, size_, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0)}
+    {
+        if (mem_ == MAP_FAILED) {
+            return;
+        }
+
+        madvise(mem_, size_, MADV_NOHUGEPAGE);
+        mpool_ = new (mem_) MPOOL;
+    }
+
+    ~SmallPageMPool()
+    {
+        if (mpool_ != nullptr) {
+            mpool_->~MPOOL();
+            munmap(mem_, size_);
+        }
+    }
+
+    SmallPageMPool(SmallPageMPool const&)            = delete;
+    SmallPageMPool& operator=(SmallPageMPool const&) = delete;
+
+    MPOOL* Get() noexcept { return mpool_; }  // mmapに失敗した場合nullptr
+
+private:
+    size_t const size_;
+    void* const  mem_;
+    MPOOL*       mpool_{nullptr};
+};
+
+struct huge_page_result {
+    double alloc_free_ns;
+    double traverse_ns;
+};
+
+huge_page_result random_and_traverse(MPool& mp)
+{
+    using clock = std::chrono::steady_clock;
+
+    static node* nodes[bench_count];
+
+    auto rng = std::mt19937{6};
+
+    for (auto& n : nodes) {
+        n = static_cast<node*>(mp.Alloc(sizeof(node)));
+    }
+
+    std::shuffle(std::begin(nodes), std::end(nodes), rng);
+    for (auto n : nodes) {  // フリーリストをメモリ上でランダムな順にする
+        mp.Free(n);
+    }
+
+    for (auto& n : nodes) {
+        n = static_cast<node*>(mp.Alloc(sizeof(node)));
+    }
+
+    // ランダムなalloc/free
+    constexpr auto loops = 1000000U;
+    auto           begin = clock::now();
+
+    for (auto i = 0U; i < loops; ++i) {
+        auto& n = nodes[rng() % bench_count];
+
+        mp.Free(n);
+        n = static_cast<node*>(mp.Alloc(sizeof(node)));
+    }
+
+    auto const alloc_free = std::chrono::duration<double, std::nano>(clock::now() - begin).count() / (2 * loops);
+
+    // 確保した順に繋いだリストの走査。各ノードはメモリ上に散らばっている
+    for (auto i = 0U; i < bench_count; ++i) {
+        nodes[i]->next  = i + 1 < bench_count ? nodes[i + 1] : nullptr;
+        nodes[i]->value = i;
+    }
+
+    constexpr auto rounds = 20U;
+    auto           sum    = uint64_t{0};
+
+    begin = clock::now();
+
+    for (auto r = 0U; r < rounds; ++r) {
+        for (auto n = nodes[0]; n != nullptr; n = n->next) {
+            sum += n->value;
+        }
+    }
+
+    auto const traverse
+        = std::chrono::duration<double, std::nano>(clock::now() - begin).count() / (rounds * bench_count);
+
+    for (auto n : nodes) {
+        mp.Free(n);
+    }
+
+    EXPECT_EQ(uint64_t{rounds} * bench_count * (bench_count - 1) / 2, sum);
+
+    return huge_page_result{alloc_free, traverse};
+}
+
+TEST(NewDelete_Opt, huge_page_benchmark)
+{
+    // @@@ sample begin 0:0
+
+    auto small = SmallPageMPool<bench_mpool>{};
+    auto huge  = HugePageMPool<bench_mpool>{};
+
+    ASSERT_NE(nullptr, small.Get());
+    ASSERT_NE(nullptr, huge.Get());
+
+    auto const s = random_and_traverse(*small.Get());
+    auto const h = random_and_traverse(*huge.Get());
+
+    std::cout << "pages             random alloc/free[ns/op]  traverse[ns/node]" << std::endl;
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << "4KB              " << std::setw(25) << s.alloc_free_ns << std::setw(19) << s.traverse_ns
+              << std::endl;
+    std::cout << "huge(" << std::setw(7) << to_str(huge.GetKind()) << ")    " << std::setw(25) << h.alloc_free_ns
+              << std::setw(19) << h.traverse_ns << std::endl;
+
+    ASSERT_EQ(bench_count, huge.Get()->GetCount());
+    // @@@ sample end
+}
+}  // namespace
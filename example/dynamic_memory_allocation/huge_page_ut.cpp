@@ -0,0 +1,61 @@
+#include <iostream>
+
+#include "gtest_wrapper.h"
+
+#include "dynamic_memory_allocation_ut.h"
+#include "huge_page.h"
+#include "mpool_fixed.h"
+#include "mpool_variable.h"
+
+namespace {
+char const* to_str(HugePageKind kind) noexcept
+{
+    switch (kind) {
+    case HugePageKind::HugeTLB:
+        return "HugeTLB";
+    case HugePageKind::THP:
+        return "THP";
+    case HugePageKind::None:
+        return "None";
+    }
+
+    return "";
+}
+
+TEST(NewDelete_Opt, huge_page_map)
+{
+    auto hp = HugePageMap(1);
+
+    ASSERT_NE(nullptr, hp.mem);
+    ASSERT_EQ(HugePageSize, hp.size);
+    ASSERT_EQ(0, reinterpret_cast<uintptr_t>(hp.mem) % HugePageSize);  // どちらの方法でも境界に揃う
+
+    static_cast<uint8_t*>(hp.mem)[HugePageSize - 1] = 1;
+
+    HugePageUnmap(hp);
+}
+
+TEST(NewDelete_Opt, huge_page_mpool)
+{
+    // @@@ sample begin 0:0
+
+    auto mpf = HugePageMPool<MPoolFixed<32, 1024>>{};
+    auto mpv = HugePageMPool<MPoolVariable<1024 * 64>>{};
+
+    ASSERT_NE(nullptr, mpf.Get());
+    ASSERT_NE(nullptr, mpv.Get());
+    std::cout << "backed by " << to_str(mpf.GetKind()) << std::endl;
+
+    auto m0 = mpf.Get()->Alloc(32);
+    auto m1 = mpv.Get()->Alloc(100);
+
+    ASSERT_EQ(0, reinterpret_cast<uintptr_t>(mpf.Get()) % HugePageSize);
+    ASSERT_TRUE(mpf.Get()->IsValid(m0));
+    ASSERT_TRUE(mpv.Get()->IsValid(m1));
+
+    mpf.Get()->Free(m0);
+    mpv.Get()->Free(m1);
+    // @@@ sample end
+}
+
+}  // namespace
@@ -0,0 +1,137 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <random>
+
+#include "gtest_wrapper.h"
+
+#include "dynamic_memory_allocation_ut.h"
+#include "free_tree.h"
+#include "malloc_free.h"
+#include "mpool_variable.h"
+#include "utils.h"
+
+namespace MallocFree {
+namespace {
+// 境界タグとBINSで管理される固定長のヒープ。ベンチマーク用
+template <typename BINS, size_t SIZE>
+class trace_heap {
+public:
+    trace_heap() noexcept
+    {
+        auto first     = reinterpret_cast<header_t*>(buff_);
+        first->n_units = ArrayLength(buff_) - 1;
+        Inner_::set_used(first, Inner_::used_tag::prev_used);
+
+        auto sentinel     = first + first->n_units;
+        sentinel->n_units = 1;
+        Inner_::set_used(sentinel, Inner_::used_tag::prev_used);
+
+        Inner_::free_block(bins_, first, no_end);
+    }
+
+    void* Alloc(size_t size) noexcept
+    {
+        auto curr = Inner_::alloc_block(bins_, Roundup(unit_size, size) / unit_size + 1, no_end);
+
+        return curr == nullptr ? nullptr : curr + 1;
+    }
+
+    void Free(void* mem) noexcept { Inner_::free_block(bins_, set_back(mem), no_end); }
+
+    // 空き領域のうち最大の空きブロックが占める割合。1に近いほどフラグメントしていない
+    double LargestFreeRatio() const noexcept
+    {
+        auto total   = size_t{0};
+        auto largest = size_t{0};
+
+        for (auto h = bins_.First(); h != nullptr; h = bins_.Next(h)) {
+            total += h->n_units;
+            largest = std::max(largest, h->n_units);
+        }
+
+        return total == 0 ? 0 : static_cast<double>(largest) / total;
+    }
+
+private:
+    header_t buff_[SIZE / unit_size];
+    BINS     bins_{};
+};
+
+struct trace_result {
+    double   ns_per_op;
+    uint32_t failed;
+    double   largest_free_ratio;
+};
+
+// 小(16～256)、中(～4K)、大(～64K)が混在する確保/解放のトレースを再生する
+template <typename HEAP>
+trace_result replay_trace(HEAP& heap)
+{
+    constexpr auto live  = 1000U;
+    constexpr auto loops = 100000U;
+
+    static void* mem[live];
+
+    auto rng  = std::mt19937{4};
+    auto size = [&rng]() -> size_t {
+        auto const r = rng() % 100;
+
+        return r < 70 ? 16 + rng() % 240 : r < 95 ? 256 + rng() % 3840 : 4096 + rng() % (60 * 1024);
+    };
+
+    auto result = trace_result{0, 0, 0};
+    auto begin  = std::chrono::steady_clock::now();
+
+    for (auto i = 0U; i < loops; ++i) {
+        auto& m = mem[rng() % live];
+
+        if (m != nullptr) {
+            heap.Free(m);
+        }
+
+        m = heap.Alloc(size());
+        result.failed += (m == nullptr);
+    }
+
+    result.ns_per_op = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - begin).count()
+                       / loops;
+    result.largest_free_ratio = heap.LargestFreeRatio();
+
+    for (auto& m : mem) {
+        if (m != nullptr) {
+            heap.Free(m);
+            m = nullptr;
+        }
+    }
+
+    return result;
+}
+
+constexpr size_t trace_heap_size{4 * 1024 * 1024};
+
+trace_heap<Inner_::free_bins, trace_heap_size> bins_heap;
+trace_heap<Inner_::free_tree, trace_heap_size> tree_heap;
+
+TEST(NewDelete_Opt, malloc_best_fit_benchmark)
+{
+    // @@@ sample begin 0:0
+
+    auto const bins = replay_trace(bins_heap);
+    auto const tree = replay_trace(tree_heap);
+
+    std::cout << "engine       free+alloc[ns/op]  failed  largest_free/free" << std::endl;
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << "free_bins" << std::setw(22) << bins.ns_per_op << std::setw(8) << bins.failed << std::setw(19)
+              << bins.largest_free_ratio << std::endl;
+    std::cout << "free_tree" << std::setw(22) << tree.ns_per_op << std::setw(8) << tree.failed << std::setw(19)
+              << tree.largest_free_ratio << std::endl;
+
+    ASSERT_EQ(1.0, bins_heap.LargestFreeRatio());  // 全て解放すれば1つの空きブロックに戻る
+    ASSERT_EQ(1.0, tree_heap.LargestFreeRatio());
+    // @@@ sample end
+}
+}  // namespace
+}  // namespace MallocFree
@@ -0,0 +1,160 @@
+#include <sys/mman.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+
+#include "free_tree.h"
+#include "malloc_free.h"
+#include "mpool_variable.h"
+#include "spin_lock.h"
+#include "utils.h"
+
+// @@@ sample begin 0:0
+
+extern "C" void* sbrk(ptrdiff_t __incr);
+// @@@ sample end
+
+namespace MallocFree {
+// @@@ sample begin 1:0
+
+namespace {
+
+// 空きブロックはサイズをキーとする木でベストフィットに管理し、前後のブロックとの結合には境界タグを使う
+// (free_tree.hのInner_::free_tree、mpool_variable.hのInner_::alloc_block、Inner_::free_block)
+Inner_::free_tree bins{};
+SpinLock          spin_lock{};
+
+void* malloc_inner(size_t size) noexcept
+{
+    // @@@ ignore begin
+    // size分のメモリとヘッダ
+    auto n_units = (Roundup(unit_size, size) / unit_size) + 1;
+    auto lock    = std::lock_guard{spin_lock};
+
+    auto curr = Inner_::alloc_block(bins, n_units, no_end);
+
+    if (curr != nullptr) {
+        ++curr;
+    }
+
+    return curr;
+    // @@@ ignore end
+}
+}  // namespace
+// @@@ sample end
+// @@@ sample begin 1:1
+
+namespace {
+// mmap_threshold以上のサイズ用
+void* malloc_mmap(size_t size) noexcept
+{
+    if (size > SIZE_MAX - unit_size - page_size) {  // ヘッダとページ境界への切り上げでオーバーフローする
+        return nullptr;
+    }
+
+    auto const bytes = Roundup(page_size, unit_size + size);
+    auto const mem   = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+    if (mem == MAP_FAILED) {
+        return nullptr;
+    }
+
+    auto header     = static_cast<header_t*>(mem);
+    header->next    = reinterpret_cast<header_t*>(mmapped_tag);
+    header->n_units = bytes / unit_size;
+
+    return header + 1;
+}
+
+void free_mmap(header_t* header) noexcept { munmap(header, header->n_units * unit_size); }
+
+header_t* top_sentinel{nullptr};  // 最後にsbrkで得た領域の番兵
+}  // namespace
+// @@@ sample end
+// @@@ sample begin 2:0
+
+void free(void* mem) noexcept
+{
+    header_t* mem_to_free = set_back(mem);
+
+    if (is_mmapped(mem_to_free)) {  // ロックは不要
+        free_mmap(mem_to_free);
+        return;
+    }
+
+    auto lock = std::lock_guard{spin_lock};
+    // @@@ sample end
+    // @@@ sample begin 2:1
+
+    // 境界タグにより前後の空きブロックをO(1)で見つけて結合し、サイズに応じたビンに戻す
+    Inner_::free_block(bins, mem_to_free, no_end);
+    // @@@ sample end
+    // @@@ sample begin 2:2
+}
+// @@@ sample end
+// @@@ sample begin 3:0
+
+void* malloc(size_t size) noexcept
+{
+    if (size >= mmap_threshold) {
+        return malloc_mmap(size);
+    }
+
+    void* mem = malloc_inner(size);
+    // @@@ sample end
+    // @@@ sample begin 3:1
+
+    if (mem == nullptr) {
+        auto const add_size = Roundup(unit_size, 1024 * 1024 + size);  // 1MB追加
+
+        header_t* add = static_cast<header_t*>(sbrk(add_size + unit_size));
+        add->n_units  = add_size / unit_size;
+        Inner_::set_used(add, Inner_::used_tag::prev_used);
+
+        header_t* sentinel = add + add->n_units;  // 番兵は常に使用中
+        sentinel->n_units  = 1;
+        Inner_::set_used(sentinel, Inner_::used_tag::prev_used);
+
+        {
+            auto lock    = std::lock_guard{spin_lock};
+            top_sentinel = sentinel;
+        }
+
+        free(++add);
+        mem = malloc_inner(size);
+    }
+    // @@@ sample end
+    // @@@ sample begin 3:2
+
+    return mem;
+}
+// @@@ sample end
+// @@@ sample begin 4:0
+
+// ヒープの末尾の空きブロックは負のsbrkで縮め、それ以外の空きブロックの内部のページはmadviseで返す
+size_t trim() noexcept
+{
+    auto lock     = std::lock_guard{spin_lock};
+    auto released = size_t{0};
+
+    // 他(glibcのmalloc等)がsbrkしていなければ、末尾の領域はヒープの末尾
+    if (top_sentinel != nullptr && Inner_::is_prev_free(top_sentinel) && sbrk(0) == top_sentinel + 1) {
+        auto tail = Inner_::prev_free_block(top_sentinel);
+
+        bins.Remove(tail);
+
+        auto const bytes = tail->n_units * unit_size;
+
+        top_sentinel          = tail;  // 空きブロックの位置に番兵を移す。その直前は使用中
+        top_sentinel->n_units = 1;
+        Inner_::set_used(top_sentinel, Inner_::used_tag::prev_used);
+
+        sbrk(-static_cast<intptr_t>(bytes));
+        released += bytes;
+    }
+
+    return released + release_free_pages(bins);
+}
+// @@@ sample end
+}  // namespace MallocFree
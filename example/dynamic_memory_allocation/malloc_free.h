@@ -0,0 +1,60 @@
+#pragma once
+#include <sys/mman.h>
+
+#include <cstddef>
+#include <cstdint>
+
+#include "mpool_variable.h"
+#include "utils.h"
+
+// @@@ sample begin 0:0
+
+// malloc_free.cppで定義するmalloc/freeの実装例。
+// 単体テストとベンチマークから使うため、標準ライブラリのmalloc/freeとは別の名前空間に置く
+namespace MallocFree {
+void* malloc(size_t size) noexcept;
+void  free(void* mem) noexcept;
+
+// 空きメモリをOSに返し、返したバイト数を返す
+size_t trim() noexcept;
+
+using Inner_::header_t;
+using Inner_::set_back;
+
+constexpr size_t unit_size{sizeof(header_t)};
+constexpr size_t page_size{4096};
+
+// sbrkで得た領域は隣接しているとは限らないため、末尾に使用中の番兵を置き、領域を越えて結合しない
+constexpr header_t const* no_end{nullptr};
+
+// これ以上のサイズは専用のmmap領域から確保し、freeでOSに返す。
+// 大きなメモリがsbrkで得たヒープに残り続けることや、ビンを汚すことを避ける
+constexpr size_t    mmap_threshold{128 * 1024};
+constexpr uintptr_t mmapped_tag{4};  // mmap領域のヘッダのnext。used_tagのいずれとも異なる値
+
+inline bool is_mmapped(header_t const* header) noexcept
+{
+    return reinterpret_cast<uintptr_t>(header->next) == mmapped_tag;
+}
+
+// 空きブロックの内部のページをmadviseでOSに返し、返したバイト数を返す。
+// 空きブロックの先頭のBINS::head_unitsユニット(ヘッダ、逆リンク、木のノード)と末尾1ユニット(フッタ)は残す
+template <typename BINS>
+size_t release_free_pages(BINS const& bins) noexcept
+{
+    auto released = size_t{0};
+
+    for (auto free_blk = bins.First(); free_blk != nullptr; free_blk = bins.Next(free_blk)) {
+        auto const begin = Roundup(page_size, reinterpret_cast<uintptr_t>(free_blk + BINS::head_units));
+        auto const end   = reinterpret_cast<uintptr_t>(free_blk + free_blk->n_units - 1) & ~(page_size - 1);
+
+        if (begin < end) {
+            madvise(reinterpret_cast<void*>(begin), end - begin, MADV_DONTNEED);
+            released += end - begin;
+        }
+    }
+
+    return released;
+}
+}  // namespace MallocFree
+// @@@ sample end
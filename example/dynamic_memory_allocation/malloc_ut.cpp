@@ -1,212 +1,198 @@
-#include <sys/unistd.h>
+#include <sys/mman.h>
 
-#include <cassert>
 #include <cstdint>
-#include <mutex>
+#include <cstring>
+#include <iostream>
 
 #include "gtest_wrapper.h"
 
 #include "dynamic_memory_allocation_ut.h"
-#include "spin_lock.h"
+#include "free_tree.h"
+#include "malloc_free.h"
 #include "utils.h"
 
-// @@@ sample begin 0:0
-
-extern "C" void* sbrk(ptrdiff_t __incr);
-// @@@ sample end
-
 namespace MallocFree {
-// @@@ sample begin 1:0
-
 namespace {
+TEST(NewDelete_Opt, malloc)
+{
+    {
+        void* mem = malloc(1024);
 
-struct header_t {
-    header_t* next;
-    size_t    n_units;  // header_tが何個あるか
-};
+        ASSERT_NE(nullptr, mem);
+        free(mem);
 
-header_t*        header{nullptr};
-SpinLock         spin_lock{};
-constexpr size_t unit_size{sizeof(header_t)};
+        void* ints[8]{};
 
-inline bool sprit(header_t* header, size_t n_units, header_t*& next) noexcept
-{
-    // @@@ ignore begin
-    assert(n_units > 1);  // ヘッダとバッファなので最低でも2
+        constexpr auto n_units = Roundup(unit_size, unit_size + sizeof(int)) / unit_size;
 
-    next = nullptr;
+        for (auto& i : ints) {
+            i = malloc(sizeof(int));
+
+            header_t* h = set_back(i);
+            ASSERT_EQ(h->n_units, n_units);
+        }
 
-    if (header->n_units == n_units || header->n_units == n_units + 1) {
-        next = header->next;
-        return true;
+        for (auto& i : ints) {
+            free(i);
+        }
     }
-    else if (header->n_units > n_units) {
-        next            = header + n_units;
-        next->n_units   = header->n_units - n_units;
-        next->next      = header->next;
-        header->n_units = n_units;
-        return true;
+
+    // @@@ sample begin 0:0
+
+    void* mem[1024];
+
+    for (auto& m : mem) {  // 32バイト x 1024個のメモリ確保
+        m = malloc(32);
     }
 
-    return false;
+    // memを使用した何らかの処理
+    // @@@ ignore begin
     // @@@ ignore end
-}
 
-inline void concat(header_t* front, header_t* rear) noexcept
-{
-    // @@@ ignore begin
-    if (front + front->n_units == rear) {  // 1枚のメモリになる
-        front->n_units += rear->n_units;
-        front->next = rear->next;
+    for (auto i = 0U; i < ArrayLength(mem); i += 2) {  // 512個のメモリを解放
+        free(mem[i]);
     }
-    else {
-        front->next = rear;
+    // @@@ sample end
+
+    for (auto i = 1U; i < ArrayLength(mem); i += 2) {
+        free(mem[i]);
     }
-    // @@@ ignore end
 }
 
-header_t* set_back(void* mem) noexcept { return static_cast<header_t*>(mem) - 1; }
-
-static_assert(sizeof(header_t) == alignof(std::max_align_t));
-
-void* malloc_inner(size_t size) noexcept
+TEST(NewDelete_Opt, malloc_coalesce)
 {
-    // @@@ ignore begin
-    // size分のメモリとヘッダ
-    auto n_units = (Roundup(unit_size, size) / unit_size) + 1;
-    auto lock    = std::lock_guard{spin_lock};
-
-    auto curr = header;
-    for (header_t* prev = nullptr; curr != nullptr; prev = curr, curr = curr->next) {
-        header_t* next;
+    constexpr auto n_units = Roundup(unit_size, unit_size + 100) / unit_size;
 
-        if (!sprit(curr, n_units, next)) {
-            continue;
-        }
+    void* a = malloc(100);
+    void* b = malloc(100);
+    void* c = malloc(100);
 
-        if (prev == nullptr) {
-            header = next;
-        }
-        else {
-            prev->next = next;
-        }
-        break;
-    }
+    ASSERT_EQ(set_back(b), set_back(a) + n_units);  // 1つの空きブロックから順に切り出される
+    ASSERT_EQ(set_back(c), set_back(b) + n_units);
 
-    if (curr != nullptr) {
-        ++curr;
-    }
+    free(a);
+    free(c);
+    ASSERT_EQ(n_units, set_back(a)->n_units);  // aの後ろのbは使用中のため結合されない
 
-    return curr;
-    // @@@ ignore end
+    free(b);  // 境界タグにより前のaと後ろのcを見つけて結合する
+    ASSERT_LE(3 * n_units, set_back(a)->n_units);
+    ASSERT_TRUE(Inner_::is_free(set_back(a)));
 }
-}  // namespace
-// @@@ sample end
-// @@@ sample begin 2:0
 
-void free(void* mem) noexcept
+TEST(NewDelete_Opt, malloc_best_fit)
 {
-    header_t* mem_to_free = set_back(mem);
+    // @@@ sample begin 1:0
 
-    mem_to_free->next = nullptr;
+    void* sep[3]{};  // 解放したブロック同士を結合させないための区切り
 
-    auto lock = std::lock_guard{spin_lock};
+    void* large  = malloc(2000);
+    sep[0]       = malloc(16);
+    void* middle = malloc(1200);
+    sep[1]       = malloc(16);
+    void* small  = malloc(600);
+    sep[2]       = malloc(16);
 
-    if (header == nullptr) {
-        header = mem_to_free;
-        return;
-    }
-    // @@@ sample end
-    // @@@ sample begin 2:1
+    free(large);
+    free(middle);
+    free(small);
 
-    if (mem_to_free < header) {
-        concat(mem_to_free, header);
-        header = mem_to_free;
-        return;
-    }
+    void* mem = malloc(1000);  // 1000以上で最小の空きブロック(middle)が選ばれる
+    ASSERT_EQ(middle, mem);
+    // @@@ sample end
 
-    auto curr = header;
-    for (; curr->next != nullptr; curr = curr->next) {
-        if (mem_to_free < curr->next) {  // 常に curr < mem_to_free
-            concat(mem_to_free, curr->next);
-            concat(curr, mem_to_free);
-            return;
-        }
+    free(mem);
+    for (auto s : sep) {
+        free(s);
     }
-
-    concat(curr, mem_to_free);
-    // @@@ sample end
-    // @@@ sample begin 2:2
 }
-// @@@ sample end
-// @@@ sample begin 3:0
 
-void* malloc(size_t size) noexcept
+TEST(NewDelete_Opt, malloc_mmap)
 {
-    void* mem = malloc_inner(size);
-    // @@@ sample end
-    // @@@ sample begin 3:1
+    // @@@ sample begin 2:0
 
-    if (mem == nullptr) {
-        auto const add_size = Roundup(unit_size, 1024 * 1024 + size);  // 1MB追加
+    constexpr auto large = 16 * 1024 * 1024;
 
-        header_t* add = static_cast<header_t*>(sbrk(add_size));
-        add->n_units  = add_size / unit_size;
-        free(++add);
-        mem = malloc_inner(size);
-    }
+    auto const rss0 = rss_kb();
+
+    void* mem = malloc(large);  // mmap_threshold以上は専用のmmap領域
+    ASSERT_TRUE(is_mmapped(set_back(mem)));
+    std::memset(mem, 1, large);
+
+    auto const rss1 = rss_kb();
+
+    free(mem);  // munmapで即座にOSに返る
+
+    auto const rss2 = rss_kb();
+
+    std::cout << "RSS[KB] before:" << rss0 << " used:" << rss1 << " freed:" << rss2 << std::endl;
+    ASSERT_GT(rss1, rss0 + large / 1024 / 2);
+    ASSERT_LT(rss2, rss1 - large / 1024 / 2);
     // @@@ sample end
-    // @@@ sample begin 3:2
 
-    return mem;
+    ASSERT_EQ(nullptr, malloc(SIZE_MAX - 10));  // ヘッダを加えるとオーバーフローするサイズ
 }
-// @@@ sample end
 
-namespace {
-TEST(NewDelete_Opt, malloc)
+TEST(NewDelete_Opt, malloc_trim_tree_node)
 {
-    {
-        void* mem = malloc(1024);
+    constexpr auto pages  = 4U;
+    auto const     region
+        = mmap(nullptr, pages * page_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    ASSERT_NE(MAP_FAILED, region);
 
-        ASSERT_NE(nullptr, mem);
-        free(mem);
+    // 木で管理される大きさで、ユニット2(木のノードのheight)がページ境界に来る空きブロック
+    auto blk     = reinterpret_cast<header_t*>(static_cast<uint8_t*>(region) + page_size - 2 * unit_size);
+    blk->n_units = (pages - 1) * page_size / unit_size;
 
-        void* ints[8]{};
+    auto tree = Inner_::free_tree{};
+    tree.Insert(blk);
 
-        constexpr auto n_units = Roundup(unit_size, unit_size + sizeof(int)) / unit_size;
+    uint8_t head[Inner_::free_tree::head_units * unit_size];
+    std::memcpy(head, blk, sizeof(head));
 
-        for (auto& i : ints) {
-            i = malloc(sizeof(int));
+    ASSERT_LT(0, release_free_pages(tree));
+    ASSERT_EQ(0, std::memcmp(head, blk, sizeof(head)));  // 木のノードはOSに返されていない
 
-            header_t* h = set_back(i);
-            ASSERT_EQ(h->n_units, n_units);
-        }
+    tree.Remove(blk);
+    ASSERT_EQ(nullptr, tree.First());
 
-        for (auto& i : ints) {
-            free(i);
-        }
-    }
+    munmap(region, pages * page_size);
+}
 
-    // @@@ sample begin 4:0
+TEST(NewDelete_Opt, malloc_trim)
+{
+    // @@@ sample begin 3:0
 
-    void* mem[1024];
+    constexpr auto size     = 4096U;
+    void*          mem[2048]{};
+    constexpr auto total_kb = ArrayLength(mem) * size / 1024;  // 8MB
 
-    for (auto& m : mem) {  // 32バイト x 1024個のメモリ確保
-        m = malloc(32);
+    auto const rss0 = rss_kb();
+
+    for (auto& m : mem) {
+        m = malloc(size);
+        std::memset(m, 1, size);
     }
 
-    // memを使用した何らかの処理
-    // @@@ ignore begin
-    // @@@ ignore end
+    auto const rss1 = rss_kb();
 
-    for (auto i = 0U; i < ArrayLength(mem); i += 2) {  // 512個のメモリを解放
-        free(mem[i]);
+    for (auto m : mem) {
+        free(m);  // sbrkで得たメモリは空きブロックになるだけで、OSには返らない
     }
+
+    auto const rss2     = rss_kb();
+    auto const released = trim();
+    auto const rss3     = rss_kb();
+
+    std::cout << "RSS[KB] before:" << rss0 << " used:" << rss1 << " freed:" << rss2 << " trimmed:" << rss3
+              << " (released " << released / 1024 << "KB)" << std::endl;
+
+    ASSERT_GT(rss2, rss0 + total_kb / 2);  // freeだけではRSSは減らない
+    ASSERT_LT(rss3, rss2 - total_kb / 2);  // trimでOSに返る
     // @@@ sample end
 
-    for (auto i = 1U; i < ArrayLength(mem); i += 2) {
-        free(mem[i]);
-    }
+    void* again = malloc(size);  // trim後も使える
+    std::memset(again, 1, size);
+    free(again);
 }
 }  // namespace
 }  // namespace MallocFree
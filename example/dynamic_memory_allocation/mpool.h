@@ -13,7 +13,9 @@ class MPoolBadAlloc : public std::bad_alloc {  // Nstd::Exceptionの基底クラ
 
 class MPool {
 public:
-    explicit MPool(size_t max_size) : max_size_{max_size} {}
+    explicit MPool(size_t max_size, size_t align = alignof(std::max_align_t)) : max_size_{max_size}, align_{align}
+    {
+    }
 
     void* Alloc(size_t size)
     {
@@ -32,17 +34,46 @@ public:
 
     void* AllocNoExcept(size_t size) noexcept { return alloc(size); }
 
+    // 最大n個のメモリをout[0]～out[n - 1]に返す。戻り値は確保できた個数で、足りなければn未満になる
+    size_t AllocBatch(size_t size, size_t n, void** out) noexcept
+    {
+        return size > max_size_ ? 0 : alloc_batch(size, n, out);
+    }
+
     void   Free(void* area) noexcept { free(area); }
+    void   FreeBatch(void* const* area, size_t n) noexcept { free_batch(area, n); }
     size_t GetSize() const noexcept { return get_size(); }           // メモリ最小単位
     size_t GetCount() const noexcept { return get_count(); }         // メモリ最小単位が何個取れるか
     size_t GetCountMin() const noexcept { return get_count_min(); }  // GetCount()の最小値
+    size_t GetMaxSize() const noexcept { return max_size_; }         // Alloc()で確保できる最大長
+    size_t GetAlign() const noexcept { return align_; }              // Alloc()が返すメモリのアラインメント
     bool   IsValid(void const* area) const noexcept { return is_valid(area); }
 
 protected:
     ~MPool() = default;
 
+    // 1個ずつのalloc/freeを繰り返す。まとめて処理できる派生クラスはオーバーライドする
+    virtual size_t alloc_batch(size_t size, size_t n, void** out) noexcept
+    {
+        for (auto i = size_t{0}; i < n; ++i) {
+            if ((out[i] = alloc(size)) == nullptr) {
+                return i;
+            }
+        }
+
+        return n;
+    }
+
+    virtual void free_batch(void* const* area, size_t n) noexcept
+    {
+        for (auto i = size_t{0}; i < n; ++i) {
+            free(area[i]);
+        }
+    }
+
 private:
     size_t const max_size_;
+    size_t const align_;
 
     virtual void*  alloc(size_t size) noexcept               = 0;
     virtual void   free(void* area) noexcept                 = 0;
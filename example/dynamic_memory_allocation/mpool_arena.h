@@ -0,0 +1,242 @@
+#pragma once
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+
+#include "mpool.h"
+#include "spin_lock.h"
+#include "suppress_warning.h"
+#include "utils.h"
+
+// @@@ sample begin 0:0
+
+// buff～buff + sizeの領域から、確保はポインタを進めるだけで、個々の解放は何もしない。
+// Reset()で全てのメモリをO(1)で解放する。MPoolArenaは現在のブロックの確保にこれを使う
+class MonotonicArena {
+public:
+    MonotonicArena(void* buff, size_t size) noexcept { Reset(buff, size); }
+
+    MonotonicArena(MonotonicArena const&)            = delete;
+    MonotonicArena& operator=(MonotonicArena const&) = delete;
+
+    void* Allocate(size_t size, size_t align) noexcept  // 足りなければnullptr
+    {
+        assert((align & (align - 1)) == 0);
+
+        auto const addr = (reinterpret_cast<uintptr_t>(curr_) + (align - 1)) & ~(uintptr_t{align} - 1);
+        auto const end  = reinterpret_cast<uintptr_t>(end_);
+
+        if (addr > end || size > end - addr) {
+            return nullptr;
+        }
+
+        curr_ = reinterpret_cast<uint8_t*>(addr) + size;
+
+        return curr_ - size;
+    }
+
+    void Reset() noexcept { curr_ = begin_; }  // このアリーナから確保した全メモリを無効にする
+
+    // 以後はbuff～buff + sizeから確保する。それまでに確保したメモリには関与しない
+    void Reset(void* buff, size_t size) noexcept
+    {
+        begin_ = static_cast<uint8_t*>(buff);
+        end_   = begin_ + size;
+        curr_  = begin_;
+    }
+
+    uint8_t* GetCurrent() const noexcept { return curr_; }  // 次の確保の先頭(アライン前)
+    size_t   GetUsed() const noexcept { return curr_ - begin_; }
+    size_t   GetRemaining() const noexcept { return end_ - curr_; }
+    size_t   GetCapacity() const noexcept { return end_ - begin_; }
+
+private:
+    uint8_t* begin_;
+    uint8_t* end_;
+    uint8_t* curr_;
+};
+
+template <size_t SIZE>
+class MonotonicArenaBuffer final : public MonotonicArena {
+public:
+    MonotonicArenaBuffer() noexcept : MonotonicArena{buff_, SIZE} {}
+
+private:
+    alignas(std::max_align_t) uint8_t buff_[SIZE];
+};
+// @@@ sample end
+// @@@ sample begin 1:0
+
+namespace Inner_ {
+// upstreamから得たブロックの先頭に置き、ブロックを逆順に辿る
+struct alignas(std::max_align_t) arena_block {
+    arena_block* prev;
+    uint8_t*     end;
+
+    uint8_t* Begin() noexcept { return reinterpret_cast<uint8_t*>(this + 1); }
+};
+}  // namespace Inner_
+
+// allocは現在のブロックのMonotonicArenaからポインタを進めて切り出すだけ、freeは何もしない可変長メモリプール。
+// メモリはReset()でまとめて、またはGetMark()で得た位置へのRewind()でそれ以降を解放する。
+// 内部のバッファが足りなくなった場合、upstreamがあればそこからblock_sizeのブロックを得て繋げる。
+// block_sizeはupstreamのGetMaxSize()で切り詰め、0ならGetMaxSize()とする。
+// MPoolVariableやMPoolTLSFのGetMaxSize()は管理領域を含むプール全体の長さで確保できないため、block_sizeを指定すること。
+// block_sizeに収まらない要求には、GetMaxSize()を上限としてその要求が収まるブロックを得る
+template <uint32_t MEM_SIZE, typename LOCK = SpinLock>  // LOCKはMPoolFixedと同じ
+class MPoolArena final : public MPool {
+public:
+    explicit MPoolArena(MPool* upstream = nullptr, size_t block_size = 0) noexcept
+        : MPool{max_size(upstream)}, upstream_{upstream}, block_size_{block_size_of(upstream, block_size)}
+    {
+    }
+    ~MPoolArena() { Reset(); }
+
+    MPoolArena(MPoolArena const&)            = delete;
+    MPoolArena& operator=(MPoolArena const&) = delete;
+
+    struct Mark {
+        Inner_::arena_block* block;
+        uint8_t*             curr;
+    };
+
+    Mark GetMark() const noexcept
+    {
+        auto lock = std::lock_guard{lock_};
+
+        return Mark{block_, arena_.GetCurrent()};
+    }
+
+    // markより後に確保したメモリを全て解放する。markは入れ子にできるが、内側から戻すこと
+    void Rewind(Mark mark) noexcept
+    {
+        auto lock = std::lock_guard{lock_};
+
+        while (block_ != mark.block) {
+            assert(block_ != nullptr);  // markは既に解放されたブロックを指している
+
+            auto prev = block_->prev;
+            upstream_->Free(block_);
+            block_ = prev;
+        }
+
+        assert(begin() <= mark.curr && mark.curr <= end());
+        arena_.Reset(mark.curr, end() - mark.curr);  // markから現在のブロックの終端までを使い直す
+    }
+
+    void Reset() noexcept { Rewind(Mark{nullptr, buff_}); }
+
+private:
+    static constexpr size_t align_{alignof(std::max_align_t)};
+    static constexpr size_t buff_size_{Roundup(align_, MEM_SIZE)};
+
+    alignas(std::max_align_t) uint8_t buff_[buff_size_];
+    MPool* const                      upstream_;
+    size_t const                      block_size_;  // upstreamから得るブロックの長さ
+    Inner_::arena_block*              block_{nullptr};  // 現在のブロック。nullptrならbuff_
+    MonotonicArena                    arena_{buff_, buff_size_};  // 現在のブロックの未使用部分
+    size_t                            count_min_{buff_size_};
+    mutable LOCK                      lock_{};
+
+    // 1回で確保できる最大長は、内部のバッファかupstreamのブロックの大きい方
+    static size_t max_size(MPool const* upstream) noexcept
+    {
+        auto const block_size = upstream == nullptr ? 0 : upstream->GetMaxSize();
+
+        return std::max(buff_size_, block_size - std::min(block_size, sizeof(Inner_::arena_block)));
+    }
+
+    static size_t block_size_of(MPool const* upstream, size_t block_size) noexcept
+    {
+        if (upstream == nullptr) {
+            return 0;
+        }
+
+        return block_size == 0 ? upstream->GetMaxSize() : std::min(block_size, upstream->GetMaxSize());
+    }
+
+    uint8_t* begin() noexcept { return block_ == nullptr ? buff_ : block_->Begin(); }
+    uint8_t* end() noexcept { return block_ == nullptr ? &buff_[buff_size_] : block_->end; }
+
+    bool grow(size_t size) noexcept
+    {
+        auto const block_size = std::max(block_size_, sizeof(Inner_::arena_block) + size);
+
+        if (upstream_ == nullptr || upstream_->GetMaxSize() < block_size) {
+            return false;
+        }
+
+        auto block = static_cast<Inner_::arena_block*>(upstream_->AllocNoExcept(block_size));
+
+        if (block == nullptr) {
+            return false;
+        }
+
+        block->prev = block_;
+        block->end  = reinterpret_cast<uint8_t*>(block) + block_size;
+
+        block_ = block;
+        arena_.Reset(block->Begin(), block->end - block->Begin());
+
+        return true;
+    }
+
+    virtual void* alloc(size_t size) noexcept override
+    {
+        auto const n = std::max(Roundup(align_, size), align_);  // 0バイトでも別のアドレスを返す
+
+        auto lock = std::lock_guard{lock_};
+
+        auto mem = arena_.Allocate(n, align_);
+
+        if (mem == nullptr && grow(n)) {
+            mem = arena_.Allocate(n, align_);
+        }
+
+        if (mem != nullptr) {
+            count_min_ = std::min(arena_.GetRemaining(), count_min_);
+        }
+
+        return mem;
+    }
+
+    virtual void free(void* mem) noexcept override  // Reset()/Rewind()でまとめて解放する
+    {
+        assert(is_valid(mem));
+        IGNORE_UNUSED_VAR(mem);
+    }
+
+    virtual size_t get_size() const noexcept override { return 1; }
+
+    // 現在のブロックの残りバイト数。upstreamから得られる分は含まない
+    virtual size_t get_count() const noexcept override
+    {
+        auto lock = std::lock_guard{lock_};
+
+        return arena_.GetRemaining();
+    }
+
+    virtual size_t get_count_min() const noexcept override { return count_min_; }
+
+    virtual bool is_valid(void const* mem) const noexcept override
+    {
+        auto const in = [mem](void const* begin, void const* end) noexcept {
+            auto const addr = reinterpret_cast<uintptr_t>(mem);
+
+            return reinterpret_cast<uintptr_t>(begin) <= addr && addr < reinterpret_cast<uintptr_t>(end);
+        };
+
+        auto lock = std::lock_guard{lock_};
+
+        for (auto block = block_; block != nullptr; block = block->prev) {
+            if (in(block->Begin(), block->end)) {
+                return true;
+            }
+        }
+
+        return in(buff_, &buff_[buff_size_]);
+    }
+};
+// @@@ sample end
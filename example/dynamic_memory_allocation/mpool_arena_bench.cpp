@@ -0,0 +1,73 @@
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+
+#include "gtest_wrapper.h"
+
+#include "dynamic_memory_allocation_ut.h"
+#include "mpool_arena.h"
+#include "mpool_fixed.h"
+#include "mpool_variable.h"
+
+namespace {
+struct node {  // 構文木のノードのようなもの
+    node* left;
+    node* right;
+    int   value[8];
+};
+
+constexpr auto tree_nodes = 1000U;
+
+MPoolArena<sizeof(node) * tree_nodes> tree_mpa;
+MPoolFixed<sizeof(node), tree_nodes>  tree_mpf;
+MPoolVariable<64 * tree_nodes>        tree_mpv;
+
+// tree_nodes個のノードの木を作ってから全て捨てることを繰り返す。戻り値は1ノードあたりの[ns]
+template <typename DISCARD>
+double build_and_discard(MPool& mp, DISCARD discard)
+{
+    constexpr auto count = 100U;
+    static node*   nodes[tree_nodes];
+
+    auto const begin = std::chrono::steady_clock::now();
+
+    for (auto c = 0U; c < count; ++c) {
+        for (auto i = 0U; i < tree_nodes; ++i) {
+            nodes[i]        = static_cast<node*>(mp.Alloc(sizeof(node)));
+            nodes[i]->left  = i == 0 ? nullptr : nodes[(i - 1) / 2];
+            nodes[i]->right = nullptr;
+        }
+
+        discard(nodes);
+    }
+
+    return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - begin).count()
+           / (count * tree_nodes);
+}
+
+TEST(NewDelete_Opt, mpool_arena_benchmark)
+{
+    // @@@ sample begin 0:0
+
+    auto free_all = [](MPool& mp) {
+        return [&mp](node* (&nodes)[tree_nodes]) {
+            for (auto n : nodes) {
+                mp.Free(n);
+            }
+        };
+    };
+
+    auto const mpa = build_and_discard(tree_mpa, [](node*(&)[tree_nodes]) { tree_mpa.Reset(); });
+    auto const mpf = build_and_discard(tree_mpf, free_all(tree_mpf));
+    auto const mpv = build_and_discard(tree_mpv, free_all(tree_mpv));
+
+    std::cout << "pool            [ns/node]" << std::endl;
+    std::cout << std::fixed << std::setprecision(1);
+    std::cout << "MPoolArena    " << std::setw(11) << mpa << std::endl;
+    std::cout << "MPoolFixed    " << std::setw(11) << mpf << std::endl;
+    std::cout << "MPoolVariable " << std::setw(11) << mpv << std::endl;
+
+    ASSERT_EQ(tree_nodes, tree_mpf.GetCount());
+    // @@@ sample end
+}
+}  // namespace
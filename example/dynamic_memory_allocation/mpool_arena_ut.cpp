@@ -0,0 +1,108 @@
+#include "gtest_wrapper.h"
+
+#include "dynamic_memory_allocation_ut.h"
+#include "mpool_arena.h"
+#include "mpool_fixed.h"
+#include "mpool_variable.h"
+#include "utils.h"
+
+namespace {
+TEST(NewDelete_Opt, mpool_arena)
+{
+    // @@@ sample begin 0:0
+
+    auto mpa = MPoolArena<256>{};
+
+    ASSERT_EQ(256, mpa.GetCount());
+
+    auto m0 = mpa.Alloc(10);  // 16バイト境界に切り上げる
+    auto m1 = mpa.Alloc(16);
+    ASSERT_EQ(static_cast<uint8_t*>(m0) + 16, m1);
+    ASSERT_EQ(256 - 32, mpa.GetCount());
+
+    mpa.Free(m0);  // 何もしない
+    ASSERT_EQ(256 - 32, mpa.GetCount());
+
+    auto const mark0 = mpa.GetMark();
+    mpa.Alloc(64);
+
+    auto const mark1 = mpa.GetMark();  // 入れ子のチェックポイント
+    mpa.Alloc(64);
+    ASSERT_EQ(256 - 160, mpa.GetCount());
+
+    mpa.Rewind(mark1);
+    ASSERT_EQ(256 - 96, mpa.GetCount());
+
+    mpa.Rewind(mark0);
+    ASSERT_EQ(256 - 32, mpa.GetCount());
+
+    ASSERT_THROW(mpa.Alloc(256), MPoolBadAlloc);  // upstreamが無いため、増やせない
+
+    mpa.Reset();
+    ASSERT_EQ(256, mpa.GetCount());
+    ASSERT_EQ(m0, mpa.Alloc(1));
+    ASSERT_EQ(256 - 160, mpa.GetCountMin());
+    // @@@ sample end
+}
+
+TEST(NewDelete_Opt, mpool_arena_upstream)
+{
+    // @@@ sample begin 1:0
+
+    auto upstream = MPoolFixed<1024, 2>{};
+    auto mpa      = MPoolArena<128>{&upstream};
+
+    auto m0 = mpa.Alloc(128);  // 内部のバッファを使い切る
+    ASSERT_EQ(2, upstream.GetCount());
+
+    auto const mark = mpa.GetMark();
+
+    auto m1 = mpa.Alloc(128);  // upstreamからブロックを得て繋げる
+    ASSERT_EQ(1, upstream.GetCount());
+    ASSERT_TRUE(mpa.IsValid(m0));
+    ASSERT_TRUE(mpa.IsValid(m1));
+
+    void* m2 = mpa.Alloc(1000 - 16);  // ブロックの残りに収まらないため、次のブロック
+    ASSERT_EQ(0, upstream.GetCount());
+    ASSERT_TRUE(mpa.IsValid(m2));
+
+    ASSERT_EQ(nullptr, mpa.AllocNoExcept(128));  // upstreamも空
+
+    mpa.Rewind(mark);  // mark以降に繋げたブロックはupstreamに返る
+    ASSERT_EQ(2, upstream.GetCount());
+    ASSERT_FALSE(mpa.IsValid(m1));
+    // @@@ sample end
+
+    ASSERT_THROW(mpa.Alloc(1024), MPoolBadAlloc);  // upstreamのブロックにも収まらない
+
+    mpa.Alloc(128);
+    ASSERT_EQ(1, upstream.GetCount());
+    mpa.Reset();
+    ASSERT_EQ(2, upstream.GetCount());
+}
+
+TEST(NewDelete_Opt, mpool_arena_variable_upstream)
+{
+    // MPoolVariableのGetMaxSize()はプール全体の長さであり、その長さのブロックは確保できない
+    auto upstream = MPoolVariable<4096>{};
+    auto mpa      = MPoolArena<128>{&upstream, 1024};
+
+    mpa.Alloc(128);  // 内部のバッファを使い切る
+
+    auto const free0 = upstream.GetCount();
+    auto       m0    = mpa.Alloc(128);  // upstreamから1024バイトのブロックを得る
+    ASSERT_TRUE(mpa.IsValid(m0));
+    ASSERT_GE(free0 - 1024, upstream.GetCount());
+
+    auto const free1 = upstream.GetCount();
+    auto       m1    = mpa.Alloc(2000);  // block_sizeに収まらないため、その要求が収まるブロックを得る
+    ASSERT_TRUE(mpa.IsValid(m1));
+    ASSERT_GT(free1 - 1024, upstream.GetCount());
+
+    ASSERT_EQ(nullptr, mpa.AllocNoExcept(4096));  // upstreamのGetMaxSize()を超える
+
+    mpa.Reset();  // ブロックは全てupstreamに返る
+    ASSERT_EQ(free0, upstream.GetCount());
+}
+
+}  // namespace
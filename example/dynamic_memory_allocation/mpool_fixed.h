@@ -1,10 +1,12 @@
 #pragma once
+#include <algorithm>
 #include <cassert>
 #include <cstddef>
 #include <cstdint>
 #include <mutex>
 
 #include "mpool.h"
+#include "mpool_magazine.h"
 #include "spin_lock.h"
 #include "utils.h"
 
@@ -13,53 +15,130 @@
 constexpr size_t MPoolFixed_MinSize{32};
 
 namespace Inner_ {
-template <uint32_t MEM_SIZE>
+template <uint32_t MEM_SIZE, size_t ALIGN = alignof(std::max_align_t)>
 union mem_chunk {
+    static_assert(ALIGN >= alignof(std::max_align_t) && (ALIGN & (ALIGN - 1)) == 0);
+
     mem_chunk* next;
 
-    // MPoolFixed_MinSizeの整数倍のエリアを、最大アラインメントが必要な基本型にアライン
-    alignas(std::max_align_t) uint8_t mem[Roundup(MPoolFixed_MinSize, MEM_SIZE)];
+    // MPoolFixed_MinSizeの整数倍のエリアを、最大アラインメントが必要な基本型(またはALIGN)にアライン
+    alignas(ALIGN) uint8_t mem[Roundup(MPoolFixed_MinSize, MEM_SIZE)];
 };
 }  // namespace Inner_
 // @@@ sample end
 // @@@ sample begin 1:0
 
-template <uint32_t MEM_SIZE, uint32_t MEM_COUNT>
+// LOCKはspin_lock.hのSpinLock、SpinLockTTAS、TicketLock、MCSLockやstd::mutex等のBasicLockable。
+// ALIGNはチャンクのアラインメント。キャッシュラインやSIMDレジスタに揃える場合に指定する
+template <uint32_t MEM_SIZE, uint32_t MEM_COUNT, typename CACHE = MPoolFixedNoCache, typename LOCK = SpinLock,
+          size_t ALIGN = alignof(std::max_align_t)>
 class MPoolFixed final : public MPool {
 public:
-    MPoolFixed() noexcept : MPool{mem_chunk_size_} {}
+    MPoolFixed() noexcept : MPool{mem_chunk_size_, ALIGN} {}
+
+    // memのチャンクの番号(0～MEM_COUNT - 1)。memはIsValid()であること
+    uint32_t GetIndex(void const* mem) const noexcept
+    {
+        assert(is_valid(mem));
+        return static_cast<uint32_t>(static_cast<chunk_t const*>(mem) - mem_chunk_);
+    }
 
 private:
-    using chunk_t = Inner_::mem_chunk<MEM_SIZE>;
+    using chunk_t = Inner_::mem_chunk<MEM_SIZE, ALIGN>;
+    using cache_t = Inner_::magazine_cache<chunk_t, CACHE>;
     static constexpr size_t mem_chunk_size_{sizeof(chunk_t)};
 
     size_t           mem_count_{MEM_COUNT};
     size_t           mem_count_min_{MEM_COUNT};
-    chunk_t          mem_chunk_[MEM_COUNT]{};
-    chunk_t*         mem_head_{setup_mem()};
-    mutable SpinLock spin_lock_{};
+    chunk_t          mem_chunk_[MEM_COUNT];  // 使われるまで触れないため、初期化しない
+    chunk_t*         mem_head_{nullptr};     // 返却されたチャンクのフリーリスト
+    uint32_t         mem_fresh_{0};          // mem_chunk_[mem_fresh_]以降は一度も使われていない
+    mutable LOCK     lock_{};
+    cache_t          cache_{};
+
+    // 終了したスレッドのマガジンのチャンクを共有フリーリストに戻す。登録を解除するデストラクタが先に走るよう最後に置く
+    typename cache_t::exit_hook_t exit_hook_{
+        [](void* ctx, uint32_t slot) noexcept { static_cast<MPoolFixed*>(ctx)->drain_magazine(slot); }, this};
+
+    // 返却されたチャンクを優先し、無ければ未使用のチャンクを先頭から切り出す。lock_を保持して呼ぶ。
+    // 全チャンクをフリーリストに繋ぐ処理をコンストラクタで行うと、全ページに触れることになり、
+    // 起動が遅くなるだけでなく、使われないチャンクまでRSSに含まれてしまう
+    chunk_t* pop_chunk() noexcept
+    {
+        if (auto mem = mem_head_; mem != nullptr) {
+            mem_head_ = mem->next;
+            return mem;
+        }
+
+        return mem_fresh_ < MEM_COUNT ? &mem_chunk_[mem_fresh_++] : nullptr;
+    }
 
-    chunk_t* setup_mem() noexcept
+    // 先頭から最大n個のチャンクをまとめて外す。外した個数はpoppedに返す
+    chunk_t* pop_chunks(uint32_t n, uint32_t& popped) noexcept
     {
-        for (auto i = 0U; i < MEM_COUNT - 1; ++i) {
-            mem_chunk_[i].next = &mem_chunk_[i + 1];
+        auto lock = std::lock_guard{lock_};
+
+        chunk_t* head{nullptr};
+        chunk_t* tail{nullptr};
+
+        for (popped = 0; popped < n; ++popped) {
+            auto mem = pop_chunk();
+
+            if (mem == nullptr) {
+                break;
+            }
+
+            (tail == nullptr ? head : tail->next) = mem;
+            tail                                  = mem;
+        }
+
+        if (tail != nullptr) {
+            tail->next = nullptr;
+            mem_count_ -= popped;
+            mem_count_min_ = std::min(mem_count_, mem_count_min_);
         }
 
-        mem_chunk_[MEM_COUNT - 1].next = nullptr;
+        return head;
+    }
+
+    // head～tailのn個のチャンクをまとめて戻す
+    void push_chunks(chunk_t* head, chunk_t* tail, uint32_t n) noexcept
+    {
+        auto lock = std::lock_guard{lock_};
+
+        tail->next = mem_head_;
+        mem_head_  = head;
+        mem_count_ += n;
+    }
+
+    void drain_magazine(uint32_t slot) noexcept
+    {
+        if constexpr (cache_t::enabled) {
+            auto spill = [this](chunk_t* head, chunk_t* tail, uint32_t n) noexcept { push_chunks(head, tail, n); };
 
-        return mem_chunk_;
+            cache_.drain(slot, spill);
+        }
     }
 
     virtual void* alloc(size_t size) noexcept override
     {
         assert(size <= mem_chunk_size_);
 
-        auto lock = std::lock_guard{spin_lock_};
+        if constexpr (cache_t::enabled) {
+            if (auto mag = cache_.get(); mag != nullptr) {
+                auto refill = [this](uint32_t n, uint32_t& popped) noexcept {
+                    return pop_chunks(n, popped);  // 共有フリーリストから1回のロックでbatch個補充
+                };
+
+                return cache_t::pop(*mag, refill);
+            }
+        }
+
+        auto lock = std::lock_guard{lock_};
 
-        auto mem = mem_head_;
+        auto mem = pop_chunk();
 
         if (mem != nullptr) {
-            mem_head_ = mem_head_->next;
             --mem_count_;
             mem_count_min_ = std::min(mem_count_, mem_count_min_);
         }
@@ -71,7 +150,18 @@ private:
     {
         assert(is_valid(mem));
 
-        auto lock = std::lock_guard{spin_lock_};
+        if constexpr (cache_t::enabled) {
+            if (auto mag = cache_.get(); mag != nullptr) {
+                auto spill = [this](chunk_t* head, chunk_t* tail, uint32_t n) noexcept {
+                    push_chunks(head, tail, n);  // 溢れた分を1回のロックでbatch個返却
+                };
+
+                cache_t::push(*mag, static_cast<chunk_t*>(mem), spill);
+                return;
+            }
+        }
+
+        auto lock = std::lock_guard{lock_};
 
         chunk_t* curr_head = static_cast<chunk_t*>(mem);
         curr_head->next    = mem_head_;
@@ -80,8 +170,47 @@ private:
         mem_count_min_ = std::min(++mem_count_, mem_count_min_);
     }
 
+    // 共有フリーリストの先頭からn個を1回のロックで外す
+    virtual size_t alloc_batch(size_t size, size_t n, void** out) noexcept override
+    {
+        assert(size <= mem_chunk_size_);
+
+        if constexpr (cache_t::enabled) {
+            return MPool::alloc_batch(size, n, out);  // マガジンを経由させる
+        }
+        else {
+            auto popped = uint32_t{0};
+            auto mem    = pop_chunks(static_cast<uint32_t>(std::min<size_t>(n, MEM_COUNT)), popped);
+
+            for (auto i = 0U; i < popped; ++i, mem = mem->next) {  // リストを辿るのはロックの外
+                out[i] = mem;
+            }
+
+            return popped;
+        }
+    }
+
+    // n個を繋いでから、1回のロックで共有フリーリストに戻す
+    virtual void free_batch(void* const* mem, size_t n) noexcept override
+    {
+        if constexpr (cache_t::enabled) {
+            MPool::free_batch(mem, n);
+        }
+        else if (n != 0) {
+            for (auto i = size_t{0}; i < n; ++i) {
+                assert(is_valid(mem[i]));
+                static_cast<chunk_t*>(mem[i])->next = i + 1 < n ? static_cast<chunk_t*>(mem[i + 1]) : nullptr;
+            }
+
+            push_chunks(static_cast<chunk_t*>(mem[0]), static_cast<chunk_t*>(mem[n - 1]), static_cast<uint32_t>(n));
+        }
+    }
+
     virtual size_t get_size() const noexcept override { return mem_chunk_size_; }
-    virtual size_t get_count() const noexcept override { return mem_count_; }
+
+    // マガジン使用時は、各スレッドのマガジンにあるチャンクも含む
+    // (GetCountMin()は共有フリーリストの最小値)
+    virtual size_t get_count() const noexcept override { return mem_count_ + cache_.count(); }
     virtual size_t get_count_min() const noexcept override { return mem_count_min_; }
 
     virtual bool is_valid(void const* mem) const noexcept override
@@ -0,0 +1,217 @@
+#pragma once
+#include <sys/mman.h>
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+
+#include "mpool.h"
+#include "mpool_fixed.h"
+#include "spin_lock.h"
+
+// @@@ sample begin 0:0
+
+// MPoolFixedと同じ固定長のメモリプールだが、チャンクを配列として持たず、
+// フリーリストが尽きた時にSLAB_SIZE単位のスラブをOSから得る。
+// 使用中のチャンクが無くなったスラブがEMPTY_SLAB_MAXを超えた場合、そのスラブはOSに返す。
+// MAX_SLABS個分の仮想アドレスを最初に予約するため、IsValid()は範囲チェックだけで済む
+// LOCKはMPoolFixedと同じ
+template <uint32_t MEM_SIZE, uint32_t MAX_SLABS, size_t SLAB_SIZE = 64 * 1024, uint32_t EMPTY_SLAB_MAX = 1,
+          typename LOCK = SpinLock>
+class MPoolFixedGrowable final : public MPool {
+public:
+    MPoolFixedGrowable() noexcept : MPool{mem_chunk_size_}
+    {
+        // 物理メモリを割り当てずにアドレスだけ予約する
+        auto base = mmap(nullptr, reserved_size_, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+
+        base_ = base == MAP_FAILED ? nullptr : static_cast<uint8_t*>(base);
+
+        for (auto i = 0U; i < MAX_SLABS; ++i) {
+            unmapped_[i] = MAX_SLABS - 1 - i;  // スラブ0から使う
+        }
+    }
+
+    ~MPoolFixedGrowable()
+    {
+        if (base_ != nullptr) {
+            munmap(base_, reserved_size_);
+        }
+    }
+
+    MPoolFixedGrowable(MPoolFixedGrowable const&)            = delete;
+    MPoolFixedGrowable& operator=(MPoolFixedGrowable const&) = delete;
+
+    size_t GetSlabCount() const noexcept { return MAX_SLABS - n_unmapped_; }  // OSから得ているスラブ数
+
+private:
+    using chunk_t = Inner_::mem_chunk<MEM_SIZE>;
+    static constexpr size_t   mem_chunk_size_{sizeof(chunk_t)};
+    static constexpr uint32_t chunks_per_slab_{SLAB_SIZE / sizeof(chunk_t)};
+    static constexpr size_t   reserved_size_{SLAB_SIZE * MAX_SLABS};
+    static constexpr uint32_t none_{MAX_SLABS};
+
+    static_assert(SLAB_SIZE % 4096 == 0, "SLAB_SIZE must be a multiple of the page size");
+    static_assert(chunks_per_slab_ > 0);
+
+    struct slab_t {
+        chunk_t* free_head{nullptr};  // このスラブ内の解放されたチャンク
+        uint32_t bump{0};             // 一度も使われていないチャンクの先頭
+        uint32_t used{0};
+        uint32_t prev{none_};  // 空きのあるスラブの双方向リスト
+        uint32_t next{none_};
+        bool     in_partial{false};
+        bool     mapped{false};
+    };
+
+    uint8_t*         base_{nullptr};
+    slab_t           slabs_[MAX_SLABS]{};
+    uint32_t         partial_head_{none_};  // 空きチャンクのあるスラブ
+    uint32_t         unmapped_[MAX_SLABS];  // OSに返してあるスラブのスタック
+    uint32_t         n_unmapped_{MAX_SLABS};
+    uint32_t         empty_slabs_{0};  // OSから得ているが使用中チャンクが無いスラブ数
+    size_t           mem_count_{size_t{chunks_per_slab_} * MAX_SLABS};
+    size_t           mem_count_min_{size_t{chunks_per_slab_} * MAX_SLABS};
+    mutable LOCK     lock_{};
+
+    uint8_t* slab_addr(uint32_t index) const noexcept { return base_ + SLAB_SIZE * index; }
+
+    void push_partial(uint32_t index) noexcept
+    {
+        auto& slab = slabs_[index];
+
+        slab.prev       = none_;
+        slab.next       = partial_head_;
+        slab.in_partial = true;
+
+        if (partial_head_ != none_) {
+            slabs_[partial_head_].prev = index;
+        }
+        partial_head_ = index;
+    }
+
+    void remove_partial(uint32_t index) noexcept
+    {
+        auto& slab = slabs_[index];
+
+        if (slab.prev != none_) {
+            slabs_[slab.prev].next = slab.next;
+        }
+        else {
+            partial_head_ = slab.next;
+        }
+
+        if (slab.next != none_) {
+            slabs_[slab.next].prev = slab.prev;
+        }
+
+        slab.in_partial = false;
+    }
+
+    bool map_slab() noexcept
+    {
+        if (base_ == nullptr || n_unmapped_ == 0) {
+            return false;
+        }
+
+        auto const index = unmapped_[n_unmapped_ - 1];
+
+        if (mprotect(slab_addr(index), SLAB_SIZE, PROT_READ | PROT_WRITE) != 0) {
+            return false;
+        }
+
+        --n_unmapped_;
+        slabs_[index]        = slab_t{};
+        slabs_[index].mapped = true;
+        ++empty_slabs_;
+        push_partial(index);
+
+        return true;
+    }
+
+    void unmap_slab(uint32_t index) noexcept
+    {
+        remove_partial(index);
+
+        madvise(slab_addr(index), SLAB_SIZE, MADV_DONTNEED);  // 物理メモリを返す
+        mprotect(slab_addr(index), SLAB_SIZE, PROT_NONE);
+
+        slabs_[index].mapped = false;
+        --empty_slabs_;
+        unmapped_[n_unmapped_++] = index;
+    }
+
+    virtual void* alloc(size_t size) noexcept override
+    {
+        assert(size <= mem_chunk_size_);
+
+        auto lock = std::lock_guard{lock_};
+
+        if (partial_head_ == none_ && !map_slab()) {
+            return nullptr;
+        }
+
+        auto const index = partial_head_;
+        auto&      slab  = slabs_[index];
+        chunk_t*   mem;
+
+        if (slab.free_head != nullptr) {
+            mem            = slab.free_head;
+            slab.free_head = mem->next;
+        }
+        else {  // 初めて使うチャンクは、この時に初めてページに触れる
+            mem = reinterpret_cast<chunk_t*>(slab_addr(index)) + slab.bump++;
+        }
+
+        if (slab.used++ == 0) {
+            --empty_slabs_;
+        }
+
+        if (slab.used == chunks_per_slab_) {
+            remove_partial(index);
+        }
+
+        --mem_count_;
+        mem_count_min_ = std::min(mem_count_, mem_count_min_);
+
+        return mem;
+    }
+
+    virtual void free(void* mem) noexcept override
+    {
+        assert(is_valid(mem));
+
+        auto lock = std::lock_guard{lock_};
+
+        auto const index = static_cast<uint32_t>((static_cast<uint8_t*>(mem) - base_) / SLAB_SIZE);  // スラブはO(1)で求まる
+        auto&      slab  = slabs_[index];
+        auto       chunk = static_cast<chunk_t*>(mem);
+
+        chunk->next    = slab.free_head;
+        slab.free_head = chunk;
+
+        if (!slab.in_partial) {
+            push_partial(index);
+        }
+
+        if (--slab.used == 0 && ++empty_slabs_ > EMPTY_SLAB_MAX) {
+            unmap_slab(index);
+        }
+
+        mem_count_min_ = std::min(++mem_count_, mem_count_min_);
+    }
+
+    virtual size_t get_size() const noexcept override { return mem_chunk_size_; }
+    virtual size_t get_count() const noexcept override { return mem_count_; }
+    virtual size_t get_count_min() const noexcept override { return mem_count_min_; }
+
+    virtual bool is_valid(void const* mem) const noexcept override
+    {
+        auto const offset = reinterpret_cast<uintptr_t>(mem) - reinterpret_cast<uintptr_t>(base_);
+
+        return base_ != nullptr && offset < reserved_size_ && slabs_[offset / SLAB_SIZE].mapped
+               && offset % SLAB_SIZE < chunks_per_slab_ * mem_chunk_size_;
+    }
+};
+// @@@ sample end
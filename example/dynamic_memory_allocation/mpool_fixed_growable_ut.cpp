@@ -0,0 +1,73 @@
+#include "gtest_wrapper.h"
+
+#include "dynamic_memory_allocation_ut.h"
+#include "mpool_fixed_growable.h"
+#include "utils.h"
+
+namespace {
+TEST(NewDelete_Opt, mpool_fixed_growable)
+{
+    // @@@ sample begin 0:0
+
+    // 64バイトのチャンクが4KBのスラブに64個。スラブは最大4枚
+    auto mpf = MPoolFixedGrowable<64, 4, 4096>{};
+
+    ASSERT_EQ(64, mpf.GetSize());
+    ASSERT_EQ(4 * 64, mpf.GetCount());
+    ASSERT_EQ(0, mpf.GetSlabCount());  // 最初はOSからメモリを得ていない
+    ASSERT_FALSE(mpf.IsValid(&mpf));
+
+    void* mem[4 * 64];
+    for (auto i = 0U; i < ArrayLength(mem); ++i) {
+        mem[i] = mpf.Alloc(64);
+        ASSERT_TRUE(mpf.IsValid(mem[i]));
+        ASSERT_EQ(i / 64 + 1, mpf.GetSlabCount());  // フリーリストが尽きるたびにスラブを得る
+    }
+
+    ASSERT_EQ(0, mpf.GetCount());
+    ASSERT_EQ(0, mpf.GetCountMin());
+    ASSERT_THROW(mpf.Alloc(64), MPoolBadAlloc);  // MAX_SLABS枚を使い切った
+
+    for (auto i = 0U; i < ArrayLength(mem); ++i) {
+        mpf.Free(mem[i]);
+    }
+
+    ASSERT_EQ(4 * 64, mpf.GetCount());
+    ASSERT_EQ(1, mpf.GetSlabCount());  // 空のスラブはEMPTY_SLAB_MAX(1)枚だけ残し、他はOSに返す
+    // @@@ sample end
+
+    auto m0 = mpf.Alloc(1);  // 残したスラブが再利用される
+    ASSERT_TRUE(mpf.IsValid(m0));
+    ASSERT_EQ(1, mpf.GetSlabCount());
+    mpf.Free(m0);
+}
+
+TEST(NewDelete_Opt, mpool_fixed_growable_reuse)
+{
+    auto mpf = MPoolFixedGrowable<32, 8, 4096, 0>{};  // 空のスラブは全て返す
+
+    void* mem[3 * 128];
+    for (auto& m : mem) {
+        m = mpf.Alloc(32);
+        *static_cast<uint32_t*>(m) = 0xdeadbeef;  // チャンクの全ページに触れられるはず
+    }
+    ASSERT_EQ(3, mpf.GetSlabCount());
+
+    for (auto i = 0U; i < 128; ++i) {  // 2枚目のスラブだけを空にする
+        mpf.Free(mem[128 + i]);
+    }
+    ASSERT_EQ(2, mpf.GetSlabCount());
+    ASSERT_FALSE(mpf.IsValid(mem[128]));  // 返したスラブのアドレスは無効
+
+    for (auto i = 0U; i < 128; ++i) {
+        mem[128 + i] = mpf.Alloc(32);
+    }
+    ASSERT_EQ(3, mpf.GetSlabCount());
+
+    for (auto m : mem) {
+        mpf.Free(m);
+    }
+    ASSERT_EQ(0, mpf.GetSlabCount());
+    ASSERT_EQ(8 * 128, mpf.GetCount());
+}
+}  // namespace
@@ -0,0 +1,106 @@
+#pragma once
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+
+#include "mpool.h"
+#include "mpool_fixed.h"
+
+// @@@ sample begin 0:0
+
+// MPoolFixedのSpinLock + mem_head_をtagged pointerのCASスタック(Treiber stack)に置き換えたもの
+// ロックを保持したままプリエンプトされたスレッドが他のスレッドを止めることがない
+template <uint32_t MEM_SIZE, uint32_t MEM_COUNT>
+class MPoolFixedLockFree final : public MPool {
+public:
+    MPoolFixedLockFree() noexcept : MPool{mem_chunk_size_}
+    {
+        for (auto i = 0U; i < MEM_COUNT; ++i) {
+            next_[i].store(i + 1, std::memory_order_relaxed);  // next_[MEM_COUNT - 1]はnull_index
+        }
+    }
+
+private:
+    using chunk_t = Inner_::mem_chunk<MEM_SIZE>;
+    static constexpr size_t mem_chunk_size_{sizeof(chunk_t)};
+
+    static_assert(MEM_COUNT < std::numeric_limits<uint32_t>::max());
+    static constexpr uint32_t null_index{MEM_COUNT};
+
+    // 上位32ビットが世代(tag)、下位32ビットがチャンクのインデックス。
+    // pop/pushのたびに世代を進めるため、ABA問題が起きてもCASが失敗する
+    static constexpr uint64_t pack(uint32_t index, uint64_t tag) noexcept { return (tag << 32) | index; }
+    static constexpr uint32_t index_of(uint64_t head) noexcept { return static_cast<uint32_t>(head); }
+    static constexpr uint64_t tag_of(uint64_t head) noexcept { return head >> 32; }
+
+    chunk_t mem_chunk_[MEM_COUNT]{};
+
+    // チャンク本体はユーザが書き換えるため、次のインデックスはチャンクの外に置く
+    std::atomic<uint32_t> next_[MEM_COUNT];
+    std::atomic<uint64_t> head_{pack(0, 0)};
+    std::atomic<size_t>   mem_count_{MEM_COUNT};
+    std::atomic<size_t>   mem_count_min_{MEM_COUNT};
+
+    static_assert(std::atomic<uint64_t>::is_always_lock_free);
+
+    void update_count_min(size_t count) noexcept
+    {
+        auto min = mem_count_min_.load(std::memory_order_relaxed);
+
+        while (count < min && !mem_count_min_.compare_exchange_weak(min, count, std::memory_order_relaxed)) {
+            ;
+        }
+    }
+
+    virtual void* alloc(size_t size) noexcept override
+    {
+        assert(size <= mem_chunk_size_);
+
+        auto head = head_.load(std::memory_order_acquire);
+
+        for (;;) {
+            auto const index = index_of(head);
+
+            if (index == null_index) {
+                return nullptr;
+            }
+
+            auto const next = next_[index].load(std::memory_order_relaxed);
+
+            if (head_.compare_exchange_weak(head, pack(next, tag_of(head) + 1), std::memory_order_acquire,
+                                            std::memory_order_acquire)) {
+                update_count_min(mem_count_.fetch_sub(1, std::memory_order_relaxed) - 1);
+                return &mem_chunk_[index];
+            }
+        }
+    }
+
+    virtual void free(void* mem) noexcept override
+    {
+        assert(is_valid(mem));
+
+        auto const index = static_cast<uint32_t>(static_cast<chunk_t*>(mem) - mem_chunk_);
+        auto       head  = head_.load(std::memory_order_relaxed);
+
+        // チャンクを公開するCASより前に数える。
+        // そのチャンクを得たalloc()のfetch_subはこのfetch_addの後になるため、mem_count_が0を下回ることはない
+        mem_count_.fetch_add(1, std::memory_order_relaxed);
+
+        do {
+            next_[index].store(index_of(head), std::memory_order_relaxed);
+        } while (!head_.compare_exchange_weak(head, pack(index, tag_of(head) + 1), std::memory_order_release,
+                                              std::memory_order_relaxed));
+    }
+
+    virtual size_t get_size() const noexcept override { return mem_chunk_size_; }
+    virtual size_t get_count() const noexcept override { return mem_count_.load(std::memory_order_relaxed); }
+    virtual size_t get_count_min() const noexcept override { return mem_count_min_.load(std::memory_order_relaxed); }
+
+    virtual bool is_valid(void const* mem) const noexcept override
+    {
+        return (&mem_chunk_[0] <= mem) && (mem <= &mem_chunk_[MEM_COUNT - 1]);
+    }
+};
+// @@@ sample end
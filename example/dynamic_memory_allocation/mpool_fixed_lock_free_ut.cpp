@@ -0,0 +1,45 @@
+#include "gtest_wrapper.h"
+
+#include "dynamic_memory_allocation_ut.h"
+#include "mpool_fixed_lock_free.h"
+
+namespace {
+TEST(NewDelete_Opt, mpool_lock_free_alloc_free)
+{
+    // @@@ sample begin 0:0
+
+    auto mpf = MPoolFixedLockFree<33, 2>{};
+
+    ASSERT_EQ(64, mpf.GetSize());
+    ASSERT_EQ(2, mpf.GetCount());
+    ASSERT_EQ(2, mpf.GetCountMin());
+    ASSERT_FALSE(mpf.IsValid(&mpf));  // mpfの管理外のアドレス
+
+    auto m0 = mpf.Alloc(1);
+    ASSERT_TRUE(mpf.IsValid(m0));  // mpfの管理のアドレス
+    ASSERT_EQ(1, mpf.GetCount());
+    ASSERT_EQ(1, mpf.GetCountMin());
+
+    auto m1 = mpf.Alloc(1);
+    ASSERT_TRUE(mpf.IsValid(m1));  // mpfの管理のアドレス
+    ASSERT_NE(m0, m1);
+    ASSERT_EQ(0, mpf.GetCount());
+    ASSERT_EQ(0, mpf.GetCountMin());
+
+    // mpfが空の場合のテスト
+    ASSERT_THROW(mpf.Alloc(1), MPoolBadAlloc);  // MPoolBadAlloc例外が発生するはず
+    ASSERT_EQ(nullptr, mpf.AllocNoExcept(1));
+
+    mpf.Free(m0);
+    ASSERT_EQ(1, mpf.GetCount());
+    ASSERT_EQ(0, mpf.GetCountMin());
+
+    mpf.Free(m1);
+    ASSERT_EQ(2, mpf.GetCount());
+    ASSERT_EQ(0, mpf.GetCountMin());
+
+    ASSERT_EQ(m1, mpf.Alloc(1));                  // 最後にFreeしたチャンクが先頭
+    ASSERT_THROW(mpf.Alloc(65), MPoolBadAlloc);  // MPoolBadAlloc例外が発生するはず
+    // @@@ sample end
+}
+}  // namespace
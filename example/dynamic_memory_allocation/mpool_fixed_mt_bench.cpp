@@ -0,0 +1,177 @@
+#include <atomic>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "gtest_wrapper.h"
+
+#include "dynamic_memory_allocation_ut.h"
+#include "mpool_fixed.h"
+#include "mpool_fixed_lock_free.h"
+#include "mpool_fixed_mt_ut.h"
+#include "mpool_fixed_remote_free.h"
+#include "spin_lock.h"
+
+namespace {
+MPoolFixed<32, mt_mem_count>                         mpf_no_cache;
+MPoolFixed<32, mt_mem_count, MPoolFixedMagazine<16>> mpf_magazine;
+MPoolFixedLockFree<32, mt_mem_count>                 mpf_lock_free;
+
+TEST(NewDelete_Opt, mpool_fixed_mt_benchmark)
+{
+    // @@@ sample begin 0:0
+
+    auto errors = std::atomic<uint32_t>{0};
+
+    std::cout << "threads  no_cache[Mops/s]  magazine[Mops/s]  lock_free[Mops/s]" << std::endl;
+
+    for (auto n_threads = 1U; n_threads <= 64; n_threads *= 2) {
+        auto const loops = 16 * 1024 / n_threads;  // スレッド数によらず総操作回数を揃える
+
+        auto const no_cache  = alloc_free_mt(mpf_no_cache, n_threads, loops, errors);
+        auto const magazine  = alloc_free_mt(mpf_magazine, n_threads, loops, errors);
+        auto const lock_free = alloc_free_mt(mpf_lock_free, n_threads, loops, errors);
+
+        std::cout << std::setw(7) << n_threads << std::fixed << std::setprecision(2) << std::setw(18)
+                  << no_cache / 1e6 << std::setw(18) << magazine / 1e6 << std::setw(19) << lock_free / 1e6
+                  << std::endl;
+    }
+
+    ASSERT_EQ(0, errors);
+    // @@@ sample end
+}
+
+template <typename LOCK>
+using mpf_lock_t = MPoolFixed<32, mt_mem_count, MPoolFixedNoCache, LOCK>;
+
+mpf_lock_t<SpinLock>     mpf_spin_lock;
+mpf_lock_t<SpinLockTTAS> mpf_ttas;
+mpf_lock_t<TicketLock>   mpf_ticket;
+mpf_lock_t<MCSLock>      mpf_mcs;
+mpf_lock_t<std::mutex>   mpf_mutex;
+
+TEST(NewDelete_Opt, mpool_fixed_lock_benchmark)
+{
+    // @@@ sample begin 1:0
+
+    auto errors = std::atomic<uint32_t>{0};
+
+    std::cout << "threads  [Mops/s]   SpinLock  SpinLockTTAS  TicketLock   MCSLock  std::mutex" << std::endl;
+
+    for (auto n_threads = 1U; n_threads <= 64; n_threads *= 2) {
+        auto const loops = 4 * 1024 / n_threads;
+
+        std::cout << std::setw(7) << n_threads << std::fixed << std::setprecision(2) << std::setw(21)
+                  << alloc_free_mt(mpf_spin_lock, n_threads, loops, errors) / 1e6 << std::setw(14)
+                  << alloc_free_mt(mpf_ttas, n_threads, loops, errors) / 1e6 << std::setw(12)
+                  << alloc_free_mt(mpf_ticket, n_threads, loops, errors) / 1e6 << std::setw(10)
+                  << alloc_free_mt(mpf_mcs, n_threads, loops, errors) / 1e6 << std::setw(12)
+                  << alloc_free_mt(mpf_mutex, n_threads, loops, errors) / 1e6 << std::endl;
+    }
+
+    ASSERT_EQ(0, errors);
+    // @@@ sample end
+}
+
+// ServerOK::dispatch()がnewしたstd::stringをClientOK::Client::wait_done()がdeleteするのと同じ形の負荷。
+// パイプの代わりにSPSCキューを使い、メモリの確保/解放以外のコストを小さくする
+struct alignas(64) dip_queue {
+    static constexpr uint32_t capacity{64};
+
+    void*                             buff[capacity];
+    alignas(64) std::atomic<uint32_t> head;  // クライアントが進める
+    alignas(64) std::atomic<uint32_t> tail;  // サーバーが進める
+};
+
+constexpr uint32_t dip_clients_max{8};
+
+dip_queue dip_queues[dip_clients_max];
+
+MPoolFixed<32, mt_mem_count>           mpf_dip;
+MPoolFixedRemoteFree<32, mt_mem_count> mpf_dip_remote_free;
+
+// 1スレッドのサーバーがn_clients個のクライアントに交互にメモリを送り、各クライアントがそれを解放する。
+// 戻り値は1メッセージ当たりの所要時間[ns]
+double server_client(MPool& mp, uint32_t n_clients, uint32_t messages, std::atomic<uint32_t>& errors)
+{
+    for (auto& q : dip_queues) {
+        q.head = 0;
+        q.tail = 0;
+    }
+
+    auto clients = std::vector<std::thread>{};
+    clients.reserve(n_clients);
+
+    for (auto c = 0U; c < n_clients; ++c) {
+        clients.emplace_back([&mp, &errors, &q = dip_queues[c], n = messages / n_clients] {
+            for (auto i = 0U; i < n; ++i) {
+                auto const head = q.head.load(std::memory_order_relaxed);
+
+                while (q.tail.load(std::memory_order_acquire) == head) {
+                    std::this_thread::yield();
+                }
+
+                auto mem = q.buff[head % dip_queue::capacity];
+                q.head.store(head + 1, std::memory_order_release);
+
+                if (mem == nullptr || *static_cast<uint32_t*>(mem) != head) {
+                    errors.fetch_add(1, std::memory_order_relaxed);
+                }
+                if (mem != nullptr) {
+                    mp.Free(mem);  // wait_done()の戻り値のunique_ptrによるdelete
+                }
+            }
+        });
+    }
+
+    auto const begin = std::chrono::steady_clock::now();
+
+    for (auto i = 0U; i < messages / n_clients * n_clients; ++i) {  // dispatch()
+        auto&      q    = dip_queues[i % n_clients];
+        auto const tail = q.tail.load(std::memory_order_relaxed);
+
+        while (tail - q.head.load(std::memory_order_acquire) == dip_queue::capacity) {
+            std::this_thread::yield();
+        }
+
+        auto mem = mp.AllocNoExcept(32);
+        if (mem != nullptr) {
+            *static_cast<uint32_t*>(mem) = tail;
+        }
+
+        q.buff[tail % dip_queue::capacity] = mem;
+        q.tail.store(tail + 1, std::memory_order_release);
+    }
+
+    for (auto& c : clients) {
+        c.join();
+    }
+
+    auto const ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - begin).count();
+
+    return ns / (messages / n_clients * n_clients);
+}
+
+TEST(NewDelete_Opt, mpool_fixed_remote_free_benchmark)
+{
+    // @@@ sample begin 2:0
+
+    auto errors = std::atomic<uint32_t>{0};
+
+    std::cout << "clients  MPoolFixed[ns/msg]  MPoolFixedRemoteFree[ns/msg]" << std::endl;
+
+    for (auto n_clients = 1U; n_clients <= dip_clients_max; n_clients *= 2) {
+        std::cout << std::setw(7) << n_clients << std::fixed << std::setprecision(1) << std::setw(20)
+                  << server_client(mpf_dip, n_clients, 64 * 1024, errors) << std::setw(30)
+                  << server_client(mpf_dip_remote_free, n_clients, 64 * 1024, errors) << std::endl;
+    }
+
+    ASSERT_EQ(0, errors);
+    ASSERT_EQ(mt_mem_count, mpf_dip.GetCount());
+    ASSERT_EQ(mt_mem_count, mpf_dip_remote_free.GetCount());
+    // @@@ sample end
+}
+}  // namespace
@@ -0,0 +1,179 @@
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "gtest_wrapper.h"
+
+#include "dynamic_memory_allocation_ut.h"
+#include "mpool_fixed.h"
+#include "mpool_fixed_lock_free.h"
+#include "mpool_fixed_mt_ut.h"
+#include "mpool_fixed_remote_free.h"
+#include "utils.h"
+
+namespace {
+TEST(NewDelete_Opt, mpool_fixed_magazine)
+{
+    // @@@ sample begin 0:0
+
+    auto mpf = MPoolFixed<32, 16, MPoolFixedMagazine<4>>{};
+
+    ASSERT_EQ(32, mpf.GetSize());
+    ASSERT_EQ(16, mpf.GetCount());
+
+    auto m0 = mpf.Alloc(32);  // 共有フリーリストから4個をマガジンへ移し、そのうちの1個を返す
+    ASSERT_TRUE(mpf.IsValid(m0));
+    ASSERT_EQ(15, mpf.GetCount());     // マガジン内の3個もGetCount()に含まれる
+    ASSERT_EQ(12, mpf.GetCountMin());  // GetCountMin()は共有フリーリストの最小値
+
+    mpf.Free(m0);
+    ASSERT_EQ(16, mpf.GetCount());
+    // @@@ sample end
+
+    void* mem[16]{};
+    for (auto& m : mem) {
+        m = mpf.Alloc(32);
+        ASSERT_TRUE(mpf.IsValid(m));
+    }
+    ASSERT_EQ(0, mpf.GetCount());
+    ASSERT_EQ(nullptr, mpf.AllocNoExcept(32));
+    ASSERT_THROW(mpf.Alloc(32), MPoolBadAlloc);
+
+    for (auto i = 0U; i < ArrayLength(mem); ++i) {
+        mpf.Free(mem[i]);
+        ASSERT_EQ(i + 1, mpf.GetCount());
+    }
+}
+
+TEST(NewDelete_Opt, mpool_fixed_magazine_thread_exit)
+{
+    auto mpf = MPoolFixed<32, 16, MPoolFixedMagazine<4>>{};
+
+    mpf.Free(mpf.Alloc(32));  // このスレッドのマガジンに4個
+
+    auto th = std::thread{[&mpf] {
+        mpf.Free(mpf.Alloc(32));  // マガジンに4個を残したまま終了する
+    }};
+    th.join();
+
+    ASSERT_EQ(8, mpf.GetCountMin());
+    ASSERT_EQ(16, mpf.GetCount());
+
+    void* mem[16]{};
+    for (auto& m : mem) {  // 終了したスレッドのマガジンの分は共有フリーリストに戻されている
+        m = mpf.Alloc(32);
+    }
+    ASSERT_EQ(0, mpf.GetCount());
+    ASSERT_EQ(nullptr, mpf.AllocNoExcept(32));
+
+    for (auto m : mem) {
+        mpf.Free(m);
+    }
+    ASSERT_EQ(16, mpf.GetCount());
+}
+
+MPoolFixed<32, mt_mem_count>                         mpf_no_cache;
+MPoolFixed<32, mt_mem_count, MPoolFixedMagazine<16>> mpf_magazine;
+MPoolFixedLockFree<32, mt_mem_count>                 mpf_lock_free;
+
+TEST(NewDelete_Opt, mpool_fixed_mt)
+{
+    auto errors = std::atomic<uint32_t>{0};
+
+    alloc_free_mt(mpf_no_cache, 8, 1000, errors);
+    alloc_free_mt(mpf_magazine, 8, 1000, errors);
+    alloc_free_mt(mpf_lock_free, 8, 1000, errors);
+
+    ASSERT_EQ(0, errors);
+    ASSERT_EQ(mt_mem_count, mpf_no_cache.GetCount());
+    ASSERT_EQ(mt_mem_count, mpf_magazine.GetCount());  // マガジンに残ったチャンクも数える
+    ASSERT_EQ(mt_mem_count, mpf_lock_free.GetCount());
+}
+
+TEST(NewDelete_Opt, mpool_fixed_remote_free)
+{
+    // @@@ sample begin 1:0
+
+    auto mpf = MPoolFixedRemoteFree<32, 64>{};
+
+    ASSERT_EQ(32, mpf.GetSize());
+    ASSERT_EQ(64, mpf.GetCount());
+
+    void* mem[10]{};
+    for (auto& m : mem) {
+        m = mpf.Alloc(32);  // このスレッドが持ち主になる
+        ASSERT_TRUE(mpf.IsValid(m));
+    }
+    ASSERT_EQ(54, mpf.GetCount());  // このスレッドのヒープにある分も数える
+
+    auto th = std::thread{[&mpf, &mem] {
+        for (auto m : mem) {
+            mpf.Free(m);  // 持ち主でないため、持ち主のremoteに積まれる
+        }
+    }};
+    th.join();
+
+    ASSERT_EQ(10, mpf.GetRemoteFreeCount());
+    ASSERT_EQ(64, mpf.GetCount());
+
+    auto m = mpf.Alloc(32);  // 持ち主のヒープが空になるまでremoteは回収されない
+    mpf.Free(m);             // 持ち主による解放はremoteを経由しない
+    ASSERT_EQ(10, mpf.GetRemoteFreeCount());
+    ASSERT_EQ(64, mpf.GetCount());
+    // @@@ sample end
+
+    for (auto& m : mem) {  // remoteを回収しながら全て確保できる
+        m = mpf.Alloc(32);
+    }
+
+    void* rest[54]{};
+    for (auto& r : rest) {
+        r = mpf.Alloc(32);
+    }
+    ASSERT_EQ(0, mpf.GetCount());
+    ASSERT_EQ(nullptr, mpf.AllocNoExcept(32));
+
+    for (auto r : rest) {
+        mpf.Free(r);
+    }
+    for (auto m : mem) {
+        mpf.Free(m);
+    }
+    ASSERT_EQ(64, mpf.GetCount());
+}
+
+TEST(NewDelete_Opt, mpool_fixed_remote_free_owner_exit)
+{
+    auto mpf = MPoolFixedRemoteFree<32, 64>{};
+
+    void* mem[40]{};
+    auto  producer = std::thread{[&mpf, &mem] {
+        for (auto& m : mem) {
+            m = mpf.Alloc(32);  // producerが持ち主になる
+        }
+
+        mpf.Free(mpf.Alloc(32));  // producerのヒープにチャンクを残したまま終了する
+    }};
+    producer.join();
+
+    ASSERT_EQ(24, mpf.GetCount());  // 終了したproducerのヒープの分はMPoolFixedに返されている
+
+    for (auto m : mem) {
+        mpf.Free(m);  // 持ち主のいないremoteに積まれる
+    }
+    ASSERT_EQ(64, mpf.GetCount());
+
+    void* all[64]{};
+    for (auto& a : all) {  // MPoolFixedが空になると、持ち主のいないremoteも回収される
+        a = mpf.Alloc(32);
+    }
+    ASSERT_EQ(0, mpf.GetCount());
+    ASSERT_EQ(nullptr, mpf.AllocNoExcept(32));
+
+    for (auto a : all) {
+        mpf.Free(a);
+    }
+    ASSERT_EQ(64, mpf.GetCount());
+}
+
+}  // namespace
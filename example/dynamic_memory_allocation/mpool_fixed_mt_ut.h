@@ -0,0 +1,55 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+#include "mpool.h"
+
+// mpool_fixed_mt_ut.cppとmpool_fixed_mt_bench.cppで共用する、複数スレッドからのAlloc/Freeの負荷
+
+constexpr uint32_t mt_mem_count{4096};
+constexpr uint32_t mt_live{8};  // 1スレッドが同時に保持するチャンク数
+
+// n_threadsスレッドで、mt_live個のAlloc/Freeをloops回繰り返す。戻り値は全スレッドのops/sec
+inline double alloc_free_mt(MPool& mp, uint32_t n_threads, uint32_t loops, std::atomic<uint32_t>& errors)
+{
+    auto start = std::atomic<bool>{false};
+    auto ths   = std::vector<std::thread>{};
+
+    ths.reserve(n_threads);
+
+    for (auto t = 0U; t < n_threads; ++t) {
+        ths.emplace_back([&mp, &start, &errors, loops, t] {
+            while (!start.load(std::memory_order_acquire)) {
+                std::this_thread::yield();
+            }
+
+            void* mem[mt_live];
+            for (auto l = 0U; l < loops; ++l) {
+                for (auto& m : mem) {
+                    m                          = mp.AllocNoExcept(32);
+                    *static_cast<uint32_t*>(m) = t;  // 同じチャンクを2スレッドが取ればいずれ検出される
+                }
+                for (auto& m : mem) {
+                    if (*static_cast<uint32_t*>(m) != t) {
+                        errors.fetch_add(1, std::memory_order_relaxed);
+                    }
+                    mp.Free(m);
+                }
+            }
+        });
+    }
+
+    auto const begin = std::chrono::steady_clock::now();
+    start.store(true, std::memory_order_release);
+
+    for (auto& th : ths) {
+        th.join();
+    }
+
+    auto const sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+
+    return 2.0 * mt_live * loops * n_threads / sec;
+}
@@ -0,0 +1,259 @@
+#pragma once
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+
+#include "mpool.h"
+#include "mpool_fixed.h"
+#include "mpool_magazine.h"
+
+// @@@ sample begin 0:0
+
+namespace Inner_ {
+
+// 1スレッドが持つチャンク置き場。localは持ち主だけが触る。
+// remoteは他スレッドが解放したチャンクのMPSCスタックで、持ち主はexchangeで丸ごと取り出すためABAは起こらない
+template <typename CHUNK>
+struct alignas(64) owner_heap {
+    CHUNK*                local{nullptr};
+    std::atomic<uint32_t> local_count{0};  // 書くのは持ち主だけ。GetCount()から他スレッドが読む
+
+    alignas(64) std::atomic<CHUNK*> remote{nullptr};  // 持ち主のlocalとキャッシュラインを分ける
+    std::atomic<int32_t> remote_count{0};             // GetCount()用の概数
+
+    void AddLocalCount(int32_t n) noexcept  // 持ち主だけが呼ぶため、読み出しと書き込みを分けて良い
+    {
+        local_count.store(local_count.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+    }
+};
+}  // namespace Inner_
+
+// MPoolFixedの前段にスレッド毎のヒープを置き、チャンクを確保したスレッドをその持ち主とする。
+// 持ち主による解放はロックなしで自分のヒープに戻し、他スレッドによる解放は持ち主のremoteに積む。
+// 持ち主はlocalが空になった時にremoteをまとめて回収するため、
+// 生産者が確保して消費者が解放する場合でもMPoolFixedのロックはBATCH回に1回になる。
+// 持ち主が終了する時には、そのヒープのチャンクをMPoolFixedに返す。
+// 終了後に他スレッドが解放したチャンクは持ち主のいないremoteに積まれるが、
+// MPoolFixedが空になった時にremoteを全て回収するため、失われることはない
+template <uint32_t MEM_SIZE, uint32_t MEM_COUNT, uint32_t BATCH = 16>
+class MPoolFixedRemoteFree final : public MPool {
+public:
+    MPoolFixedRemoteFree() noexcept : MPool{sizeof(Inner_::mem_chunk<MEM_SIZE>)} {}
+
+    MPoolFixedRemoteFree(MPoolFixedRemoteFree const&)            = delete;
+    MPoolFixedRemoteFree& operator=(MPoolFixedRemoteFree const&) = delete;
+
+    size_t GetRemoteFreeCount() const noexcept { return remote_frees_.load(std::memory_order_relaxed); }
+
+private:
+    using backing_t = MPoolFixed<MEM_SIZE, MEM_COUNT>;
+    using chunk_t   = Inner_::mem_chunk<MEM_SIZE>;
+    using heap_t    = Inner_::owner_heap<chunk_t>;
+
+    static_assert(Inner_::thread_slot_none <= UINT8_MAX);
+    static constexpr uint8_t owner_none_{Inner_::thread_slot_none};
+
+    backing_t             backing_{};
+    heap_t                heaps_[Inner_::thread_slot_max]{};
+    uint8_t               owner_[MEM_COUNT]{};  // チャンク番号 -> 持ち主のスロット
+    std::atomic<uint64_t> remote_frees_{0};
+
+    // 全メンバの構築後に登録し、解体前に解除するため最後に置く
+    Inner_::ThreadExitHook exit_hook_{
+        [](void* ctx, uint32_t slot) noexcept { static_cast<MPoolFixedRemoteFree*>(ctx)->release_heap(slot); }, this};
+
+    // remoteを丸ごと取り出してlocalにする。localが空の時だけ呼ぶ
+    void drain_remote(heap_t& heap) noexcept
+    {
+        auto head = heap.remote.exchange(nullptr, std::memory_order_acquire);
+        auto n    = uint32_t{0};
+
+        for (auto c = head; c != nullptr; c = c->next) {
+            ++n;
+        }
+
+        heap.local = head;
+        heap.local_count.store(n, std::memory_order_relaxed);
+        heap.remote_count.fetch_sub(static_cast<int32_t>(n), std::memory_order_relaxed);
+    }
+
+    // 全ヒープのremoteを取り出してheapのlocalにつなぐ。MPoolFixedが空になった時に呼ぶ。
+    // 終了したスレッドのremoteに積まれたチャンクもこれで再利用される
+    void adopt_remote(heap_t& heap) noexcept
+    {
+        for (auto& other : heaps_) {
+            auto head = other.remote.exchange(nullptr, std::memory_order_acquire);
+            auto n    = int32_t{0};
+
+            while (head != nullptr) {
+                auto next  = head->next;
+                head->next = heap.local;
+                heap.local = head;
+                head       = next;
+                ++n;
+            }
+
+            other.remote_count.fetch_sub(n, std::memory_order_relaxed);
+            heap.AddLocalCount(n);
+        }
+    }
+
+    // chunkから始まるリストをBATCH個ずつMPoolFixedに返し、返した個数を返す
+    uint32_t free_list(chunk_t* chunk) noexcept
+    {
+        auto total = uint32_t{0};
+
+        while (chunk != nullptr) {
+            void* mem[BATCH];
+            auto  n = uint32_t{0};
+
+            for (; n < BATCH && chunk != nullptr; ++n, chunk = chunk->next) {
+                mem[n] = chunk;
+            }
+
+            backing_.FreeBatch(mem, n);
+            total += n;
+        }
+
+        return total;
+    }
+
+    // 終了するスレッド自身がThreadSlotのデストラクタから呼ぶため、localを触ってよい
+    void release_heap(uint32_t slot) noexcept
+    {
+        auto& heap = heaps_[slot];
+
+        heap.AddLocalCount(-static_cast<int32_t>(free_list(heap.local)));
+        heap.local = nullptr;
+
+        auto const n = free_list(heap.remote.exchange(nullptr, std::memory_order_acquire));
+        heap.remote_count.fetch_sub(static_cast<int32_t>(n), std::memory_order_relaxed);
+    }
+
+    // MPoolFixedから1回のロックで最大BATCH個を得る
+    void refill(heap_t& heap, uint8_t slot) noexcept
+    {
+        void* mem[BATCH];
+        auto  n = static_cast<uint32_t>(backing_.AllocBatch(MEM_SIZE, BATCH, mem));
+
+        for (auto i = 0U; i < n; ++i) {
+            owner_[backing_.GetIndex(mem[i])] = slot;
+
+            auto chunk  = static_cast<chunk_t*>(mem[i]);
+            chunk->next = heap.local;
+            heap.local  = chunk;
+        }
+
+        heap.AddLocalCount(static_cast<int32_t>(n));
+    }
+
+    // localが溢れたらBATCH個をMPoolFixedに1回のロックで返す
+    void spill(heap_t& heap) noexcept
+    {
+        void* mem[BATCH];
+
+        for (auto& m : mem) {
+            m          = heap.local;
+            heap.local = heap.local->next;
+        }
+
+        heap.AddLocalCount(-static_cast<int32_t>(BATCH));
+        backing_.FreeBatch(mem, BATCH);
+    }
+
+    virtual void* alloc(size_t size) noexcept override
+    {
+        assert(size <= MEM_SIZE);
+
+        auto const slot = Inner_::thread_slot();
+
+        if (slot == Inner_::thread_slot_none) {  // 持ち主になれないスレッドはMPoolFixedを直接使う
+            auto mem = backing_.AllocNoExcept(size);
+
+            if (mem != nullptr) {
+                owner_[backing_.GetIndex(mem)] = owner_none_;
+            }
+
+            return mem;
+        }
+
+        auto& heap = heaps_[slot];
+
+        if (heap.local == nullptr) {
+            drain_remote(heap);
+        }
+
+        if (heap.local == nullptr) {
+            refill(heap, static_cast<uint8_t>(slot));
+        }
+
+        if (heap.local == nullptr) {
+            adopt_remote(heap);
+        }
+
+        auto mem = heap.local;
+
+        if (mem != nullptr) {
+            heap.local = mem->next;
+            heap.AddLocalCount(-1);
+        }
+
+        return mem;
+    }
+
+    virtual void free(void* mem) noexcept override
+    {
+        assert(is_valid(mem));
+
+        auto const owner = owner_[backing_.GetIndex(mem)];
+        auto const slot  = Inner_::thread_slot();
+        auto       chunk = static_cast<chunk_t*>(mem);
+
+        if (owner == owner_none_) {
+            backing_.Free(mem);
+        }
+        else if (owner == slot) {  // 持ち主による解放。アトミック操作もロックも不要
+            auto& heap = heaps_[slot];
+
+            chunk->next = heap.local;
+            heap.local  = chunk;
+
+            heap.AddLocalCount(1);
+
+            if (heap.local_count.load(std::memory_order_relaxed) > 2 * BATCH) {
+                spill(heap);
+            }
+        }
+        else {  // 他スレッドによる解放。持ち主のremoteに積むだけで、MPoolFixedのロックには触れない
+            auto& heap = heaps_[owner];
+
+            chunk->next = heap.remote.load(std::memory_order_relaxed);
+            while (!heap.remote.compare_exchange_weak(chunk->next, chunk, std::memory_order_release,
+                                                      std::memory_order_relaxed)) {
+            }
+
+            heap.remote_count.fetch_add(1, std::memory_order_relaxed);
+            remote_frees_.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    virtual size_t get_size() const noexcept override { return backing_.GetSize(); }
+
+    // 各スレッドのヒープにあるチャンクも含む。他スレッドが更新中の値を読むため概数
+    virtual size_t get_count() const noexcept override
+    {
+        auto sum = static_cast<int64_t>(backing_.GetCount());
+
+        for (auto const& heap : heaps_) {
+            sum += heap.local_count.load(std::memory_order_relaxed);
+            sum += heap.remote_count.load(std::memory_order_relaxed);
+        }
+
+        return static_cast<size_t>(sum);
+    }
+
+    virtual size_t get_count_min() const noexcept override { return backing_.GetCountMin(); }
+    virtual bool   is_valid(void const* mem) const noexcept override { return backing_.IsValid(mem); }
+};
+// @@@ sample end
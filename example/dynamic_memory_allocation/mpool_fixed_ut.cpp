@@ -1,7 +1,12 @@
+#include <chrono>
+#include <iostream>
+#include <memory>
+
 #include "gtest_wrapper.h"
 
 #include "dynamic_memory_allocation_ut.h"
 #include "mpool_fixed.h"
+#include "mpool_variable.h"
 #include "suppress_warning.h"
 
 namespace {
@@ -142,4 +147,85 @@ TEST(NewDelete_Opt, mpool_alloc_free)
         // @@@ sample end
     }
 }
+
+TEST(NewDelete_Opt, mpool_alloc_batch)
+{
+    // @@@ sample begin 2:0
+
+    auto  mpf = MPoolFixed<32, 8>{};
+    void* mem0[5]{};
+    void* mem1[5]{};
+
+    ASSERT_EQ(5, mpf.AllocBatch(32, 5, mem0));  // 1回のロックで5個
+    ASSERT_EQ(3, mpf.GetCount());
+    ASSERT_EQ(3, mpf.AllocBatch(32, 5, mem1));  // 残りは3個
+    ASSERT_EQ(0, mpf.GetCount());
+    ASSERT_EQ(0, mpf.GetCountMin());
+
+    for (auto m : mem0) {
+        ASSERT_TRUE(mpf.IsValid(m));
+    }
+
+    mpf.FreeBatch(mem0, 5);
+    mpf.FreeBatch(mem1, 3);
+    ASSERT_EQ(8, mpf.GetCount());
+
+    ASSERT_EQ(0, mpf.AllocBatch(33, 5, mem0));  // サイズが大きすぎる
+    // @@@ sample end
+
+    // オーバーライドしないMPoolでは、1個ずつのAlloc/Freeになる
+    auto mpv = MPoolVariable<1024>{};
+
+    ASSERT_EQ(5, mpv.AllocBatch(100, 5, mem0));
+    mpv.FreeBatch(mem0, 5);
+    ASSERT_EQ(1024, mpv.GetCount());
+}
+
+TEST(NewDelete_Opt, mpool_fixed_lazy_init)
+{
+    // @@@ sample begin 3:0
+
+    using clock   = std::chrono::steady_clock;
+    using mpool_t = MPoolFixed<256, 128 * 1024>;  // 32MB
+    constexpr auto pool_kb = sizeof(mpool_t) / 1024;
+
+    auto const rss0  = rss_kb();
+    auto const begin = clock::now();
+
+    auto mpf = std::make_unique<mpool_t>();  // std::mallocのmmap領域に置かれるため、触れたページだけがRSSになる
+
+    auto const init_us = std::chrono::duration<double, std::micro>(clock::now() - begin).count();
+    auto const rss1    = rss_kb();
+
+    void* mem[1024];
+    for (auto& m : mem) {
+        m = mpf->Alloc(256);
+    }
+
+    auto const rss2 = rss_kb();
+
+    for (auto m : mem) {
+        mpf->Free(m);
+    }
+
+    std::cout << "pool[KB]:" << pool_kb << " init[us]:" << init_us << " RSS[KB] after init:" << rss1 - rss0
+              << " after 1024 allocs:" << rss2 - rss0 << std::endl;
+
+    ASSERT_LT(rss1 - rss0, pool_kb / 16);  // 未使用のチャンクのページには触れない
+    ASSERT_LT(rss2 - rss0, pool_kb / 16);
+    ASSERT_EQ(128 * 1024, mpf->GetCount());
+    // @@@ sample end
+
+    auto const first = static_cast<uint8_t*>(mem[0]);  // 未使用のチャンクは先頭から切り出される
+
+    for (auto& m : mem) {  // 返却されたチャンクが先に使われる
+        m = mpf->Alloc(256);
+        ASSERT_LE(first, m);
+        ASSERT_LT(m, first + ArrayLength(mem) * mpf->GetSize());
+    }
+
+    for (auto m : mem) {
+        mpf->Free(m);
+    }
+}
 }  // namespace
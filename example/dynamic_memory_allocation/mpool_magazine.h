@@ -0,0 +1,250 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+
+// @@@ sample begin 0:0
+
+struct MPoolFixedNoCache {  // MPoolFixedのデフォルト。スレッドキャッシュを使わない
+};
+
+// スレッド毎のマガジンをMPoolFixedの前段に置き、共有フリーリストのロックをBATCH回に1回にする
+// 各マガジンは最大BATCH * 2個のチャンクを抱えるため、他スレッドのマガジンに残ったチャンクは
+// 共有フリーリストが空でも使えないことに注意(スレッドの終了時には共有フリーリストへ返される)
+template <uint32_t BATCH = 16>
+struct MPoolFixedMagazine {
+    static_assert(BATCH > 0);
+    static constexpr uint32_t batch{BATCH};  // 共有フリーリストとの1回のやり取りで移動するチャンク数
+};
+// @@@ sample end
+// @@@ sample begin 1:0
+
+namespace Inner_ {
+
+constexpr uint32_t thread_slot_max{64};
+constexpr uint32_t thread_slot_none{thread_slot_max};  // スロットを取得できなかったスレッド
+
+// スロットを持つスレッドが終了する時に、funcをそのスロット番号で呼び出す。
+// スレッド毎の置き場を持つプールが、終了したスレッドの置き場に残ったチャンクを回収するために使う。
+// 登録はコンストラクタ、解除はデストラクタで行うため、プールのメンバとしては最後に宣言すること
+class ThreadExitHook {
+public:
+    using func_t = void (*)(void* ctx, uint32_t slot) noexcept;
+
+    ThreadExitHook(func_t func, void* ctx) noexcept : func_{func}, ctx_{ctx}
+    {
+        auto lock = std::lock_guard{mutex_};
+
+        next_ = head_;
+        head_ = this;
+    }
+
+    ~ThreadExitHook()
+    {
+        auto lock = std::lock_guard{mutex_};
+
+        for (auto h = &head_; *h != nullptr; h = &(*h)->next_) {
+            if (*h == this) {
+                *h = next_;
+                break;
+            }
+        }
+    }
+
+    ThreadExitHook(ThreadExitHook const&)            = delete;
+    ThreadExitHook& operator=(ThreadExitHook const&) = delete;
+
+    static void Run(uint32_t slot) noexcept
+    {
+        auto lock = std::lock_guard{mutex_};
+
+        for (auto h = head_; h != nullptr; h = h->next_) {
+            h->func_(h->ctx_, slot);
+        }
+    }
+
+private:
+    inline static std::mutex      mutex_{};
+    inline static ThreadExitHook* head_{nullptr};
+
+    func_t          func_;
+    void*           ctx_;
+    ThreadExitHook* next_{nullptr};
+};
+
+// 生存中のスレッドに0 ～ thread_slot_max - 1のユニークな番号を割り当てる
+class ThreadSlot {
+public:
+    ThreadSlot() noexcept : slot_{acquire()} {}
+    ~ThreadSlot()
+    {
+        if (slot_ != thread_slot_none) {
+            ThreadExitHook::Run(slot_);  // スロットを手放す前に、そのスロットの置き場を片付けさせる
+        }
+        release(slot_);
+    }
+
+    ThreadSlot(ThreadSlot const&)            = delete;
+    ThreadSlot& operator=(ThreadSlot const&) = delete;
+
+    uint32_t Get() const noexcept { return slot_; }
+
+private:
+    inline static std::atomic<uint64_t> used_{0};
+
+    uint32_t slot_;
+
+    static uint32_t acquire() noexcept
+    {
+        auto used = used_.load(std::memory_order_relaxed);
+
+        while (~used != 0) {
+            auto const slot = static_cast<uint32_t>(__builtin_ctzll(~used));
+
+            if (used_.compare_exchange_weak(used, used | (1ULL << slot), std::memory_order_acquire)) {
+                return slot;
+            }
+        }
+
+        return thread_slot_none;
+    }
+
+    static void release(uint32_t slot) noexcept
+    {
+        if (slot != thread_slot_none) {
+            used_.fetch_and(~(1ULL << slot), std::memory_order_release);
+        }
+    }
+};
+
+inline uint32_t thread_slot() noexcept
+{
+    thread_local ThreadSlot slot;
+
+    return slot.Get();
+}
+
+// 1スレッド専用のチャンク置き場。countはGetCount()から他スレッドが読むためatomic
+template <typename CHUNK>
+struct alignas(64) magazine {  // false sharingを避けるためキャッシュライン単位
+    CHUNK*                head{nullptr};
+    std::atomic<uint32_t> count{0};
+};
+
+// ThreadExitHookと同じ形で、何も登録しない
+struct no_exit_hook {
+    no_exit_hook(ThreadExitHook::func_t, void*) noexcept {}
+};
+
+template <typename CHUNK, typename CACHE>
+class magazine_cache {  // MPoolFixedNoCache用。何もしない
+public:
+    static constexpr bool enabled{false};
+
+    using exit_hook_t = no_exit_hook;
+
+    size_t count() const noexcept { return 0; }
+};
+
+template <typename CHUNK, uint32_t BATCH>
+class magazine_cache<CHUNK, MPoolFixedMagazine<BATCH>> {
+public:
+    static constexpr bool     enabled{true};
+    static constexpr uint32_t batch{BATCH};
+    static constexpr uint32_t capacity{BATCH * 2};  // これを超えたらbatch個を共有フリーリストへ返す
+
+    // プールはこれを最後のメンバとし、スレッドの終了時にdrain()を呼ばせる
+    using exit_hook_t = ThreadExitHook;
+
+    // スロットを持たないスレッドはnullptrとなり、共有フリーリストを直接使う
+    magazine<CHUNK>* get() noexcept
+    {
+        auto const slot = thread_slot();
+
+        return slot == thread_slot_none ? nullptr : &magazines_[slot];
+    }
+
+    // magから1個取り出す。空であればrefill(n, popped)で共有フリーリストから1回のロックでbatch個補充する。
+    // refillは先頭からn個を外してnullptr終端のリストで返し、外した個数をpoppedに返す
+    template <typename REFILL>
+    static CHUNK* pop(magazine<CHUNK>& mag, REFILL&& refill) noexcept
+    {
+        auto count = mag.count.load(std::memory_order_relaxed);
+
+        if (count == 0) {
+            mag.head = refill(batch, count);
+            if (count == 0) {
+                return nullptr;
+            }
+        }
+
+        auto chunk = mag.head;
+        mag.head   = chunk->next;
+        mag.count.store(count - 1, std::memory_order_relaxed);
+
+        return chunk;
+    }
+
+    // magにchunkを積む。capacityを超えたら、溢れた分をspill(head, tail, n)で1回のロックでbatch個返却する
+    template <typename SPILL>
+    static void push(magazine<CHUNK>& mag, CHUNK* chunk, SPILL&& spill) noexcept
+    {
+        auto count = mag.count.load(std::memory_order_relaxed);
+
+        chunk->next = mag.head;
+        mag.head    = chunk;
+
+        if (++count > capacity) {
+            auto tail = mag.head;
+            for (auto i = 1U; i < batch; ++i) {
+                tail = tail->next;
+            }
+
+            auto head = mag.head;
+            mag.head  = tail->next;
+            spill(head, tail, batch);
+            count -= batch;
+        }
+
+        mag.count.store(count, std::memory_order_relaxed);
+    }
+
+    // slotのマガジンを空にし、全チャンクをspill(head, tail, n)で1回のロックで返却する。
+    // スロットを持つスレッドの終了時に、そのスレッドから呼ぶ
+    template <typename SPILL>
+    void drain(uint32_t slot, SPILL&& spill) noexcept
+    {
+        auto& mag   = magazines_[slot];
+        auto  count = mag.count.load(std::memory_order_relaxed);
+
+        if (count == 0) {
+            return;
+        }
+
+        auto tail = mag.head;
+        for (auto i = 1U; i < count; ++i) {
+            tail = tail->next;
+        }
+
+        spill(mag.head, tail, count);
+        mag.head = nullptr;
+        mag.count.store(0, std::memory_order_relaxed);
+    }
+
+    // 全マガジンのチャンク数。他スレッドが更新中の値を読むため概数
+    size_t count() const noexcept
+    {
+        auto sum = size_t{0};
+
+        for (auto const& m : magazines_) {
+            sum += m.count.load(std::memory_order_relaxed);
+        }
+
+        return sum;
+    }
+
+private:
+    magazine<CHUNK> magazines_[thread_slot_max]{};
+};
+}  // namespace Inner_
+// @@@ sample end
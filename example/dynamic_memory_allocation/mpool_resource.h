@@ -0,0 +1,97 @@
+#pragma once
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+
+#include "mpool.h"
+
+// @@@ sample begin 0:0
+
+// std::pmr::memory_resourceとしてMPoolを使うためのアダプタ。
+// 要求サイズが収まる最初のMPoolから確保し、それが空なら次に大きいMPoolを使う。
+// アラインメントがMPool::GetAlign()を超えるMPoolは使わない。
+// どのMPoolからも確保できない要求(大きすぎる、アラインメントが大きい、全て空)はupstreamに回す
+class MPoolResource final : public std::pmr::memory_resource {
+public:
+    static constexpr size_t mpool_max{16};
+
+    // mpoolsはGetMaxSize()の昇順
+    template <size_t N>
+    explicit MPoolResource(MPool* const (&mpools)[N],
+                           std::pmr::memory_resource* upstream = std::pmr::get_default_resource()) noexcept
+        : upstream_{upstream}
+    {
+        static_assert(N <= mpool_max);
+
+        for (auto mp : mpools) {
+            assert(mp != nullptr);
+            assert(count_ == 0 || mpools_[count_ - 1]->GetMaxSize() <= mp->GetMaxSize());
+
+            mpools_[count_++] = mp;
+        }
+    }
+
+    MPoolResource(MPoolResource const&)            = delete;
+    MPoolResource& operator=(MPoolResource const&) = delete;
+
+    std::pmr::memory_resource* upstream_resource() const noexcept { return upstream_; }
+
+private:
+    MPool*                     mpools_[mpool_max]{};
+    size_t                     count_{0};
+    std::pmr::memory_resource* upstream_;
+
+    // bytesを確保し得る最初のMPoolのインデックス。MPoolはサイズの昇順のため、2分探索できる
+    size_t first_fit(size_t bytes) const noexcept
+    {
+        auto first = size_t{0};
+        auto last  = count_;
+
+        while (first < last) {
+            auto const mid = (first + last) / 2;
+
+            if (mpools_[mid]->GetMaxSize() < bytes) {
+                first = mid + 1;
+            }
+            else {
+                last = mid;
+            }
+        }
+
+        return first;
+    }
+
+    virtual void* do_allocate(size_t bytes, size_t alignment) override
+    {
+        for (auto i = first_fit(bytes); i < count_; ++i) {
+            if (mpools_[i]->GetAlign() < alignment) {  // ALIGNを指定したMPoolFixed以外はstd::max_align_tまで
+                continue;
+            }
+
+            if (auto mem = mpools_[i]->AllocNoExcept(bytes); mem != nullptr) {
+                return mem;
+            }
+        }
+
+        return upstream_->allocate(bytes, alignment);
+    }
+
+    virtual void do_deallocate(void* mem, size_t bytes, size_t alignment) override
+    {
+        for (auto i = first_fit(bytes); i < count_; ++i) {  // bytesより小さいMPoolから確保されることはない
+            if (mpools_[i]->GetAlign() >= alignment && mpools_[i]->IsValid(mem)) {
+                mpools_[i]->Free(mem);
+                return;
+            }
+        }
+
+        upstream_->deallocate(mem, bytes, alignment);
+    }
+
+    virtual bool do_is_equal(std::pmr::memory_resource const& other) const noexcept override
+    {
+        return this == &other;
+    }
+};
+// @@@ sample end
@@ -0,0 +1,145 @@
+#include <map>
+#include <memory_resource>
+#include <string>
+#include <vector>
+
+#include "gtest_wrapper.h"
+
+#include "dynamic_memory_allocation_ut.h"
+#include "mpool_fixed.h"
+#include "mpool_resource.h"
+#include "mpool_variable.h"
+
+namespace {
+TEST(NewDelete_Opt, mpool_resource)
+{
+    // @@@ sample begin 0:0
+
+    auto mpf32  = MPoolFixed<32, 4>{};
+    auto mpf128 = MPoolFixed<128, 4>{};
+    auto mpv    = MPoolVariable<1024 * 4>{};
+
+    // 大きなメモリはupstreamから得る。ここではスタック上のバッファを使う
+    uint8_t                             buff[8 * 1024];
+    std::pmr::monotonic_buffer_resource upstream{buff, sizeof(buff), std::pmr::null_memory_resource()};
+
+    auto resource = MPoolResource{{&mpf32, &mpf128, &mpv}, &upstream};
+
+    void* m0 = resource.allocate(20);
+    ASSERT_TRUE(mpf32.IsValid(m0));
+
+    void* m1 = resource.allocate(100);
+    ASSERT_TRUE(mpf128.IsValid(m1));
+
+    void* m2 = resource.allocate(1000);
+    ASSERT_TRUE(mpv.IsValid(m2));
+
+    void* m3 = resource.allocate(5000);  // どのMPoolにも収まらない
+    ASSERT_LE(static_cast<void*>(buff), m3);
+    ASSERT_LT(m3, static_cast<void*>(&buff[sizeof(buff)]));
+
+    void* m4 = resource.allocate(32, 64);  // MPoolでは満たせないアラインメント
+    ASSERT_EQ(0, reinterpret_cast<uintptr_t>(m4) % 64);
+    ASSERT_FALSE(mpf32.IsValid(m4));
+
+    resource.deallocate(m4, 32, 64);
+    resource.deallocate(m3, 5000);
+    resource.deallocate(m2, 1000);
+    resource.deallocate(m1, 100);
+    resource.deallocate(m0, 20);
+
+    ASSERT_EQ(4, mpf32.GetCount());
+    ASSERT_EQ(4, mpf128.GetCount());
+    // @@@ sample end
+}
+
+TEST(NewDelete_Opt, mpool_resource_fallback)
+{
+    auto mpf32  = MPoolFixed<32, 2>{};
+    auto mpf128 = MPoolFixed<128, 2>{};
+
+    uint8_t                             buff[1024];
+    std::pmr::monotonic_buffer_resource upstream{buff, sizeof(buff), std::pmr::null_memory_resource()};
+
+    auto resource = MPoolResource{{&mpf32, &mpf128}, &upstream};
+
+    void* mem[5]{};
+    for (auto& m : mem) {
+        m = resource.allocate(32);
+    }
+
+    ASSERT_TRUE(mpf32.IsValid(mem[1]));
+    ASSERT_TRUE(mpf128.IsValid(mem[2]));  // 32バイトのプールが空のため、次に大きいプールから
+    ASSERT_TRUE(mpf128.IsValid(mem[3]));
+    ASSERT_FALSE(mpf128.IsValid(mem[4]));  // 全て空のため、upstreamから
+
+    for (auto m : mem) {
+        resource.deallocate(m, 32);
+    }
+
+    ASSERT_EQ(2, mpf32.GetCount());
+    ASSERT_EQ(2, mpf128.GetCount());
+}
+
+TEST(NewDelete_Opt, mpool_resource_aligned)
+{
+    auto mpf64  = MPoolFixed<64, 4>{};                                   // std::max_align_tにアライン
+    auto mpf64a = MPoolFixed<64, 4, MPoolFixedNoCache, SpinLock, 64>{};  // キャッシュラインにアライン
+
+    ASSERT_EQ(alignof(std::max_align_t), mpf64.GetAlign());
+    ASSERT_EQ(64, mpf64a.GetAlign());
+
+    uint8_t                             buff[1024];
+    std::pmr::monotonic_buffer_resource upstream{buff, sizeof(buff), std::pmr::null_memory_resource()};
+
+    auto resource = MPoolResource{{&mpf64, &mpf64a}, &upstream};
+
+    void* m0 = resource.allocate(48);       // 収まる最初のMPoolから
+    void* m1 = resource.allocate(48, 64);   // mpf64は64にアラインしないため、mpf64aから
+    void* m2 = resource.allocate(48, 128);  // どのMPoolもアラインしないため、upstreamから
+
+    ASSERT_TRUE(mpf64.IsValid(m0));
+    ASSERT_TRUE(mpf64a.IsValid(m1));
+    ASSERT_EQ(0, reinterpret_cast<uintptr_t>(m1) % 64);
+    ASSERT_FALSE(mpf64.IsValid(m2) || mpf64a.IsValid(m2));
+    ASSERT_EQ(0, reinterpret_cast<uintptr_t>(m2) % 128);
+
+    resource.deallocate(m2, 48, 128);
+    resource.deallocate(m1, 48, 64);
+    resource.deallocate(m0, 48);
+
+    ASSERT_EQ(4, mpf64.GetCount());
+    ASSERT_EQ(4, mpf64a.GetCount());
+}
+
+TEST(NewDelete_Opt, mpool_resource_container)
+{
+    // @@@ sample begin 1:0
+
+    auto mpf32 = MPoolFixed<32, 64>{};
+    auto mpv   = MPoolVariable<1024 * 16>{};
+
+    uint8_t                             buff[1024 * 16];
+    std::pmr::monotonic_buffer_resource upstream{buff, sizeof(buff), std::pmr::null_memory_resource()};
+
+    auto resource = MPoolResource{{&mpf32, &mpv}, &upstream};
+
+    // コンテナ毎のアロケータ型を作らずに、MPoolを使うことができる
+    {
+        auto vec = std::pmr::vector<int>{{1, 2, 3}, &resource};
+        auto str = std::pmr::string{"a string longer than the small string buffer", &resource};
+        auto map = std::pmr::map<int, std::pmr::string>{&resource};
+
+        map[0] = "zero";  // mapのノードは32バイトを超えるため、mpvから
+        map[1] = "one";
+
+        ASSERT_TRUE(mpf32.IsValid(vec.data()));
+        ASSERT_TRUE(mpv.IsValid(str.data()));
+        ASSERT_EQ(2, map.size());
+        ASSERT_GT(64, mpf32.GetCount());
+    }
+
+    ASSERT_EQ(64, mpf32.GetCount());  // 全て返却されている
+    // @@@ sample end
+}
+}  // namespace
@@ -0,0 +1,279 @@
+#pragma once
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+
+#include "mpool.h"
+#include "spin_lock.h"
+#include "utils.h"
+
+// @@@ sample begin 0:0
+
+namespace Inner_ {
+namespace TLSF {
+
+// 物理的に隣接するブロックを辿るためのヘッダ。
+// next_free/prev_freeは空きブロックの時のみ有効で、使用中はユーザ領域の先頭になる
+struct block_t {
+    block_t* prev_phys;  // 物理的に直前のブロック(先頭ブロックではnullptr)
+    size_t   size;       // ユーザ領域のバイト数。最下位ビットは空きフラグ
+    block_t* next_free;
+    block_t* prev_free;
+
+    static constexpr size_t free_bit{1};
+
+    size_t   Size() const noexcept { return size & ~free_bit; }
+    bool     IsFree() const noexcept { return (size & free_bit) != 0; }
+    void     SetSize(size_t s, bool is_free) noexcept { size = s | (is_free ? free_bit : 0); }
+    void*    Mem() noexcept { return &next_free; }
+    block_t* NextPhys() noexcept { return reinterpret_cast<block_t*>(static_cast<uint8_t*>(Mem()) + Size()); }
+
+    static block_t* FromMem(void* mem) noexcept
+    {
+        return reinterpret_cast<block_t*>(static_cast<uint8_t*>(mem) - header_size);
+    }
+
+    static constexpr size_t header_size{sizeof(block_t*) + sizeof(size_t)};  // 使用中ブロックのオーバーヘッド
+};
+
+constexpr size_t align_size{alignof(std::max_align_t)};
+constexpr size_t min_block_size{sizeof(block_t) - block_t::header_size};  // 空きリストのリンク分
+
+static_assert(block_t::header_size == align_size);
+static_assert(min_block_size % align_size == 0);
+
+// 第2レベルの分割数は2^sl_log2。small_block_size未満は第1レベル0に線形に割り当てる
+constexpr uint32_t sl_log2{4};
+constexpr uint32_t sl_count{1U << sl_log2};
+constexpr uint32_t fl_shift{sl_log2 + 4};  // log2(align_size) == 4
+constexpr size_t   small_block_size{size_t{1} << fl_shift};
+
+static_assert(align_size == 16);
+
+inline uint32_t fls(size_t v) noexcept  // 最上位の1のビット位置
+{
+    assert(v != 0);
+    return 63 - __builtin_clzll(v);
+}
+
+constexpr uint32_t fls_constexpr(size_t v) noexcept { return v <= 1 ? 0 : 1 + fls_constexpr(v >> 1); }
+
+// sizeが属する(第1レベル, 第2レベル)。このリストのブロックは全てsize以上とは限らない
+inline void mapping_insert(size_t size, uint32_t& fl, uint32_t& sl) noexcept
+{
+    if (size < small_block_size) {
+        fl = 0;
+        sl = static_cast<uint32_t>(size / (small_block_size / sl_count));
+    }
+    else {
+        auto const f = fls(size);
+
+        sl = static_cast<uint32_t>(size >> (f - sl_log2)) ^ sl_count;
+        fl = f - (fl_shift - 1);
+    }
+}
+
+// そのリストのどのブロックもsize以上であるような(第1レベル, 第2レベル)
+inline void mapping_search(size_t size, uint32_t& fl, uint32_t& sl) noexcept
+{
+    if (size >= small_block_size) {
+        size += (size_t{1} << (fls(size) - sl_log2)) - 1;
+    }
+
+    mapping_insert(size, fl, sl);
+}
+}  // namespace TLSF
+}  // namespace Inner_
+// @@@ sample end
+// @@@ sample begin 1:0
+
+// Two-Level Segregated Fitによる可変長メモリプール。
+// 空きブロックをサイズの2段階の区分毎のリストで管理し、ビットマップで空でないリストを探すため、
+// alloc/freeはフラグメントの程度によらずO(1)となる
+template <uint32_t MEM_SIZE, typename LOCK = SpinLock>  // LOCKはMPoolFixedと同じ
+class MPoolTLSF final : public MPool {
+public:
+    MPoolTLSF() noexcept : MPool{MEM_SIZE}
+    {
+        auto first = reinterpret_cast<block_t*>(buff_);
+
+        first->prev_phys = nullptr;
+        first->SetSize(first_block_size_, true);
+
+        auto sentinel = first->NextPhys();  // 末尾の番兵。使用中扱いにして結合を止める
+
+        sentinel->prev_phys = first;
+        sentinel->SetSize(0, false);
+
+        insert_free(first);
+    }
+
+private:
+    using block_t = Inner_::TLSF::block_t;
+
+    static constexpr size_t first_block_size_{Roundup(Inner_::TLSF::align_size, MEM_SIZE)};
+    static constexpr size_t buff_size_{block_t::header_size + first_block_size_ + block_t::header_size};
+
+    static constexpr uint32_t fl_count_{
+        first_block_size_ < Inner_::TLSF::small_block_size
+            ? 1
+            : Inner_::TLSF::fls_constexpr(first_block_size_) - (Inner_::TLSF::fl_shift - 1) + 1};
+
+    static_assert(fl_count_ <= 32);
+    static_assert(first_block_size_ >= Inner_::TLSF::min_block_size);
+
+    alignas(std::max_align_t) uint8_t buff_[buff_size_];
+    uint32_t                          fl_bitmap_{0};
+    uint32_t                          sl_bitmap_[fl_count_]{};
+    block_t*                          free_[fl_count_][Inner_::TLSF::sl_count]{};
+    mutable LOCK                      lock_{};
+    size_t                            count_{block_t::header_size + first_block_size_};
+    size_t                            count_min_{block_t::header_size + first_block_size_};
+
+    void insert_free(block_t* block) noexcept
+    {
+        uint32_t fl;
+        uint32_t sl;
+        Inner_::TLSF::mapping_insert(block->Size(), fl, sl);
+
+        block->prev_free = nullptr;
+        block->next_free = free_[fl][sl];
+
+        if (block->next_free != nullptr) {
+            block->next_free->prev_free = block;
+        }
+
+        free_[fl][sl] = block;
+        fl_bitmap_ |= 1U << fl;
+        sl_bitmap_[fl] |= 1U << sl;
+    }
+
+    void remove_free(block_t* block) noexcept
+    {
+        uint32_t fl;
+        uint32_t sl;
+        Inner_::TLSF::mapping_insert(block->Size(), fl, sl);
+
+        if (block->next_free != nullptr) {
+            block->next_free->prev_free = block->prev_free;
+        }
+
+        if (block->prev_free != nullptr) {
+            block->prev_free->next_free = block->next_free;
+        }
+        else {
+            free_[fl][sl] = block->next_free;
+
+            if (free_[fl][sl] == nullptr) {
+                sl_bitmap_[fl] &= ~(1U << sl);
+
+                if (sl_bitmap_[fl] == 0) {
+                    fl_bitmap_ &= ~(1U << fl);
+                }
+            }
+        }
+    }
+
+    block_t* search_suitable(uint32_t fl, uint32_t sl) const noexcept
+    {
+        if (fl >= fl_count_) {
+            return nullptr;
+        }
+
+        auto sl_map = sl_bitmap_[fl] & (~0U << sl);
+
+        if (sl_map == 0) {
+            auto const fl_map = fl + 1 < 32 ? fl_bitmap_ & (~0U << (fl + 1)) : 0;
+
+            if (fl_map == 0) {
+                return nullptr;
+            }
+
+            fl     = __builtin_ctz(fl_map);
+            sl_map = sl_bitmap_[fl];
+        }
+
+        return free_[fl][__builtin_ctz(sl_map)];
+    }
+
+    virtual void* alloc(size_t size) noexcept override
+    {
+        // @@@ ignore begin
+        auto const adjust = std::max(Roundup(Inner_::TLSF::align_size, size), Inner_::TLSF::min_block_size);
+
+        uint32_t fl;
+        uint32_t sl;
+        Inner_::TLSF::mapping_search(adjust, fl, sl);
+
+        auto lock = std::lock_guard{lock_};
+
+        auto block = search_suitable(fl, sl);
+
+        if (block == nullptr) {
+            return nullptr;
+        }
+
+        remove_free(block);
+
+        if (block->Size() >= adjust + sizeof(block_t)) {  // 残りが空きブロックになれる場合は分割
+            auto rest = reinterpret_cast<block_t*>(static_cast<uint8_t*>(block->Mem()) + adjust);
+
+            rest->prev_phys = block;
+            rest->SetSize(block->Size() - adjust - block_t::header_size, true);
+            rest->NextPhys()->prev_phys = rest;
+            block->SetSize(adjust, true);
+
+            insert_free(rest);
+        }
+
+        block->SetSize(block->Size(), false);
+
+        count_ -= block_t::header_size + block->Size();
+        count_min_ = std::min(count_, count_min_);
+
+        return block->Mem();
+        // @@@ ignore end
+    }
+
+    virtual void free(void* mem) noexcept override
+    {
+        // @@@ ignore begin
+        assert(is_valid(mem));
+
+        auto block = block_t::FromMem(mem);
+
+        auto lock = std::lock_guard{lock_};
+
+        assert(!block->IsFree());
+        count_ += block_t::header_size + block->Size();
+
+        if (auto prev = block->prev_phys; prev != nullptr && prev->IsFree()) {  // 前のブロックと結合
+            remove_free(prev);
+            prev->SetSize(prev->Size() + block_t::header_size + block->Size(), true);
+            block = prev;
+            block->NextPhys()->prev_phys = block;
+        }
+
+        if (auto next = block->NextPhys(); next->IsFree()) {  // 後ろのブロックと結合
+            remove_free(next);
+            block->SetSize(block->Size() + block_t::header_size + next->Size(), true);
+            block->NextPhys()->prev_phys = block;
+        }
+
+        block->SetSize(block->Size(), true);
+        insert_free(block);
+        // @@@ ignore end
+    }
+
+    virtual size_t get_size() const noexcept override { return 1; }
+    virtual size_t get_count() const noexcept override { return count_; }
+    virtual size_t get_count_min() const noexcept override { return count_min_; }
+
+    virtual bool is_valid(void const* mem) const noexcept override
+    {
+        return (&buff_[0] < mem) && (mem < &buff_[buff_size_ - block_t::header_size]);
+    }
+};
+// @@@ sample end
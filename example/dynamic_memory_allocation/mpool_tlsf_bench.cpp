@@ -0,0 +1,90 @@
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <random>
+
+#include "gtest_wrapper.h"
+
+#include "dynamic_memory_allocation_ut.h"
+#include "mpool_tlsf.h"
+#include "mpool_variable.h"
+
+namespace {
+constexpr auto frag_mem_size = 1024U * 1024;
+
+MPoolVariable<frag_mem_size> frag_mpv;
+MPoolTLSF<frag_mem_size>     frag_mpt;
+
+struct frag_result {
+    double   ns_per_op;
+    double   ns_max;
+    uint32_t failed;
+};
+
+// 大きさの異なるメモリの確保/解放をランダムに繰り返し、フラグメントさせながら計測する
+frag_result fragmenting_workload(MPool& mp)
+{
+    using clock = std::chrono::steady_clock;
+
+    constexpr auto live = 2048U;
+    static void*   mem[live];
+
+    auto rng    = std::mt19937{2};
+    auto size   = [&rng] { return 16 + rng() % 256; };
+    auto result = frag_result{0, 0, 0};
+
+    for (auto& m : mem) {
+        m = mp.AllocNoExcept(size());
+    }
+
+    constexpr auto loops = 20000U;
+    auto const     begin = clock::now();
+
+    for (auto i = 0U; i < loops; ++i) {
+        auto& m = mem[rng() % live];
+        auto  s = size();
+
+        auto const op_begin = clock::now();
+
+        if (m != nullptr) {
+            mp.Free(m);
+        }
+        m = mp.AllocNoExcept(s);
+
+        auto const ns = std::chrono::duration<double, std::nano>(clock::now() - op_begin).count();
+
+        result.ns_max = std::max(result.ns_max, ns);
+        result.failed += (m == nullptr);
+    }
+
+    result.ns_per_op = std::chrono::duration<double, std::nano>(clock::now() - begin).count() / loops;
+
+    for (auto& m : mem) {
+        if (m != nullptr) {
+            mp.Free(m);
+        }
+    }
+
+    return result;
+}
+
+TEST(NewDelete_Opt, mpool_tlsf_benchmark)
+{
+    // @@@ sample begin 0:0
+
+    auto const mpv = fragmenting_workload(frag_mpv);
+    auto const mpt = fragmenting_workload(frag_mpt);
+
+    std::cout << "pool           free+alloc[ns/op]  max[ns]  failed" << std::endl;
+    std::cout << std::fixed << std::setprecision(1);
+    std::cout << "MPoolVariable" << std::setw(20) << mpv.ns_per_op << std::setw(9) << mpv.ns_max << std::setw(8)
+              << mpv.failed << std::endl;
+    std::cout << "MPoolTLSF    " << std::setw(20) << mpt.ns_per_op << std::setw(9) << mpt.ns_max << std::setw(8)
+              << mpt.failed << std::endl;
+
+    ASSERT_EQ(frag_mpv.GetCount(), frag_mem_size);
+    ASSERT_EQ(frag_mpt.GetCount(), Inner_::TLSF::block_t::header_size + frag_mem_size);
+    // @@@ sample end
+}
+}  // namespace
@@ -0,0 +1,121 @@
+#include <algorithm>
+#include <random>
+
+#include "gtest_wrapper.h"
+
+#include "dynamic_memory_allocation_ut.h"
+#include "mpool_tlsf.h"
+#include "mpool_variable.h"
+#include "utils.h"
+
+namespace {
+TEST(NewDelete_Opt, tlsf_mapping)
+{
+    using Inner_::TLSF::mapping_insert;
+    using Inner_::TLSF::mapping_search;
+
+    uint32_t fl;
+    uint32_t sl;
+
+    mapping_insert(16, fl, sl);  // small_block_size未満は16バイト刻み
+    ASSERT_EQ(0, fl);
+    ASSERT_EQ(1, sl);
+
+    mapping_insert(240, fl, sl);
+    ASSERT_EQ(0, fl);
+    ASSERT_EQ(15, sl);
+
+    mapping_insert(256, fl, sl);  // 256～271
+    ASSERT_EQ(1, fl);
+    ASSERT_EQ(0, sl);
+
+    mapping_insert(1023, fl, sl);  // 992～1023
+    ASSERT_EQ(2, fl);
+    ASSERT_EQ(15, sl);
+
+    mapping_search(257, fl, sl);  // 256～271には257未満のブロックもあるため、次の区分から探す
+    ASSERT_EQ(1, fl);
+    ASSERT_EQ(1, sl);
+
+    mapping_search(1024, fl, sl);  // 区分の先頭ならそのまま
+    ASSERT_EQ(3, fl);
+    ASSERT_EQ(0, sl);
+}
+
+TEST(NewDelete_Opt, mpool_tlsf_alloc_free)
+{
+    // @@@ sample begin 0:0
+
+    constexpr auto mem_size = 1024U;
+    auto           mpt      = MPoolTLSF<mem_size>{};
+
+    constexpr auto header_size = Inner_::TLSF::block_t::header_size;
+
+    ASSERT_EQ(1, mpt.GetSize());
+    ASSERT_EQ(header_size + mem_size, mpt.GetCount());
+    ASSERT_FALSE(mpt.IsValid(&mpt));
+
+    void* mem[8]{};
+    for (auto& m : mem) {
+        m = mpt.Alloc(100);  // 112バイト + ヘッダ
+        ASSERT_TRUE(mpt.IsValid(m));
+        ASSERT_EQ(0, reinterpret_cast<uintptr_t>(m) % alignof(std::max_align_t));
+    }
+    ASSERT_EQ(0, mpt.GetCount());  // 最後のブロックの余り16バイトは分割できないため、そのまま渡される
+
+    ASSERT_THROW(mpt.Alloc(mem_size + 1), MPoolBadAlloc);  // サイズが大きすぎる
+    ASSERT_EQ(nullptr, mpt.AllocNoExcept(1));
+
+    for (auto i = 0U; i < ArrayLength(mem); i += 2) {  // 1個おきに解放し、フラグメントさせる
+        mpt.Free(mem[i]);
+    }
+    ASSERT_EQ(nullptr, mpt.AllocNoExcept(200));  // 隣接していない空きは結合されない
+
+    for (auto i = 1U; i < ArrayLength(mem); i += 2) {
+        mpt.Free(mem[i]);
+    }
+
+    // 全て結合され、最初の状態に戻る
+    ASSERT_EQ(header_size + mem_size, mpt.GetCount());
+
+    auto all = mpt.Alloc(mem_size);
+    ASSERT_NE(nullptr, all);
+    ASSERT_EQ(0, mpt.GetCount());
+    ASSERT_EQ(0, mpt.GetCountMin());
+
+    mpt.Free(all);
+    ASSERT_EQ(header_size + mem_size, mpt.GetCount());
+    // @@@ sample end
+}
+
+TEST(NewDelete_Opt, mpool_tlsf_random)
+{
+    auto mpt = MPoolTLSF<1024 * 16>{};
+    auto rng = std::mt19937{1};
+
+    auto const initial = mpt.GetCount();
+
+    void* mem[64]{};
+    for (auto i = 0U; i < 10000; ++i) {
+        auto& m = mem[rng() % ArrayLength(mem)];
+
+        if (m == nullptr) {
+            m = mpt.AllocNoExcept(1 + rng() % 512);
+        }
+        else {
+            mpt.Free(m);
+            m = nullptr;
+        }
+    }
+
+    for (auto m : mem) {
+        if (m != nullptr) {
+            mpt.Free(m);
+        }
+    }
+
+    ASSERT_EQ(initial, mpt.GetCount());
+    ASSERT_NE(nullptr, mpt.AllocNoExcept(1024 * 16));  // 1つのブロックに戻っている
+}
+
+}  // namespace
@@ -1,4 +1,5 @@
 #pragma once
+#include <algorithm>
 #include <cassert>
 #include <cstdint>
 #include <mutex>
@@ -8,6 +9,23 @@
 #include "spin_lock.h"
 #include "utils.h"
 
+// 空きブロックの統計。MPoolVariable::GetFreeStats()がO(1)で返す
+struct FreeBlockStats {
+    static constexpr size_t histogram_size{64};
+
+    size_t   free_bytes;      // 空きブロックの合計(ヘッダを含む)
+    size_t   largest_block;   // 最大の空きブロック(ヘッダを含む)
+    size_t   max_alloc_size;  // Alloc()が成功する最大長
+    uint32_t free_blocks;     // 空きブロックの個数
+    uint32_t histogram[histogram_size];  // [i]は長さが[2^i, 2^(i+1))バイトの空きブロックの個数
+
+    // 0は断片化なし(空きが1ブロック)。1に近いほど、空きの合計に対して確保できる最大長が小さい
+    double Fragmentation() const noexcept
+    {
+        return free_bytes == 0 ? 0.0 : 1.0 - static_cast<double>(largest_block) / free_bytes;
+    }
+};
+
 namespace Inner_ {
 
 struct header_t {
@@ -54,33 +72,488 @@ template <uint32_t MEM_SIZE>
 struct buffer_t {
     alignas(std::max_align_t) uint8_t buffer[Roundup(sizeof(header_t), MEM_SIZE)];
 };
+
+// 境界タグ
+// 使用中ブロックのnextには下記のタグを置き、空きブロック(nextはビンのリストのリンク)と区別する。
+// 空きブロックは、末尾にn_unitsを、2番目のheader_tのnextにビンのリストの逆リンクを持つ。
+// これにより、前後のブロックが空きか否か、その先頭はどこかがO(1)でわかる
+enum class used_tag : uintptr_t {
+    prev_used = 1,  // 直前のブロックは使用中(または直前にブロックがない)
+    prev_free = 2,  // 直前のブロックは空き
+};
+
+inline void set_used(header_t* header, used_tag tag) noexcept
+{
+    header->next = reinterpret_cast<header_t*>(static_cast<uintptr_t>(tag));
+}
+
+inline bool is_free(header_t const* header) noexcept
+{
+    auto const next = reinterpret_cast<uintptr_t>(header->next);
+
+    return next != static_cast<uintptr_t>(used_tag::prev_used) && next != static_cast<uintptr_t>(used_tag::prev_free);
+}
+
+inline bool is_prev_free(header_t const* header) noexcept
+{
+    return reinterpret_cast<uintptr_t>(header->next) == static_cast<uintptr_t>(used_tag::prev_free);
+}
+
+inline header_t*& prev_link(header_t* header) noexcept { return (header + 1)->next; }
+
+inline void set_footer(header_t* header) noexcept { (header + header->n_units - 1)->n_units = header->n_units; }
+
+// headerの直前の空きブロック。is_prev_free(header)の時のみ有効
+inline header_t* prev_free_block(header_t* header) noexcept { return header - (header - 1)->n_units; }
+
+// 空きブロックを(n_units, アドレス)の順に並べるAVL木の操作。
+// NODEはheader、left、right、heightを持ち、空きブロック自体に置く。free_binsとfree_tree.hのfree_treeが使う
+template <typename NODE>
+struct avl_tree {
+    static bool less(NODE const* lhs, NODE const* rhs) noexcept
+    {
+        return lhs->header.n_units != rhs->header.n_units
+                   ? lhs->header.n_units < rhs->header.n_units
+                   : reinterpret_cast<uintptr_t>(lhs) < reinterpret_cast<uintptr_t>(rhs);
+    }
+
+    static size_t height(NODE const* node) noexcept { return node == nullptr ? 0 : node->height; }
+
+    static void update(NODE* node) noexcept
+    {
+        auto const l = height(node->left);
+        auto const r = height(node->right);
+
+        node->height = (l > r ? l : r) + 1;
+    }
+
+    static NODE* rotate_right(NODE* node) noexcept
+    {
+        auto left   = node->left;
+        node->left  = left->right;
+        left->right = node;
+
+        update(node);
+        update(left);
+
+        return left;
+    }
+
+    static NODE* rotate_left(NODE* node) noexcept
+    {
+        auto right  = node->right;
+        node->right = right->left;
+        right->left = node;
+
+        update(node);
+        update(right);
+
+        return right;
+    }
+
+    // 左右の高さの差を1以内に戻す
+    static NODE* balance(NODE* node) noexcept
+    {
+        update(node);
+
+        auto const l = height(node->left);
+        auto const r = height(node->right);
+
+        if (l > r + 1) {
+            if (height(node->left->left) < height(node->left->right)) {
+                node->left = rotate_left(node->left);
+            }
+            return rotate_right(node);
+        }
+
+        if (r > l + 1) {
+            if (height(node->right->right) < height(node->right->left)) {
+                node->right = rotate_right(node->right);
+            }
+            return rotate_left(node);
+        }
+
+        return node;
+    }
+
+    static NODE* insert(NODE* root, NODE* node) noexcept
+    {
+        if (root == nullptr) {
+            node->left   = nullptr;
+            node->right  = nullptr;
+            node->height = 1;
+
+            return node;
+        }
+
+        if (less(node, root)) {
+            root->left = insert(root->left, node);
+        }
+        else {
+            root->right = insert(root->right, node);
+        }
+
+        return balance(root);
+    }
+
+    static NODE* remove_min(NODE* root, NODE*& min) noexcept
+    {
+        if (root->left == nullptr) {
+            min = root;
+            return root->right;
+        }
+
+        root->left = remove_min(root->left, min);
+
+        return balance(root);
+    }
+
+    static NODE* remove(NODE* root, NODE* node) noexcept
+    {
+        assert(root != nullptr);  // nodeは木にない
+
+        if (root == node) {
+            if (root->right == nullptr) {
+                return root->left;
+            }
+
+            NODE* min;
+            auto  right = remove_min(root->right, min);
+
+            min->left  = root->left;
+            min->right = right;
+
+            return balance(min);
+        }
+
+        if (less(node, root)) {
+            root->left = remove(root->left, node);
+        }
+        else {
+            root->right = remove(root->right, node);
+        }
+
+        return balance(root);
+    }
+
+    // n_units以上で最小のノード
+    static NODE* lower_bound(NODE* root, size_t n_units) noexcept
+    {
+        NODE* found = nullptr;
+
+        for (auto node = root; node != nullptr;) {
+            if (node->header.n_units >= n_units) {
+                found = node;
+                node  = node->left;
+            }
+            else {
+                node = node->right;
+            }
+        }
+
+        return found;
+    }
+
+    static NODE const* successor(NODE const* root, NODE const* target) noexcept
+    {
+        NODE const* found = nullptr;
+
+        for (auto node = root; node != nullptr;) {
+            if (less(target, node)) {
+                found = node;
+                node  = node->left;
+            }
+            else {
+                node = node->right;
+            }
+        }
+
+        return found;
+    }
+
+    static NODE const* min(NODE const* root) noexcept
+    {
+        for (; root != nullptr && root->left != nullptr; root = root->left) {
+            ;
+        }
+
+        return root;
+    }
+
+    static NODE const* max(NODE const* root) noexcept
+    {
+        for (; root != nullptr && root->right != nullptr; root = root->right) {
+            ;
+        }
+
+        return root;
+    }
+};
+
+// 空きブロックを、n_unitsの2のべき乗毎のビンで管理する。
+// 統計はInsert/Removeで更新するため、GetStats()は空きブロックを辿らない。
+// 最大の空きブロックを正確に保つため、小さい空きブロックはn_units毎の個数で、
+// 大きい空きブロックはビンのリストに加えてAVL木でも管理する(Insert/RemoveはO(log n))
+class free_bins {
+public:
+    void Insert(header_t* header) noexcept
+    {
+        assert(header->n_units > 1);  // 逆リンクとフッタのため、空きブロックは最低でも2
+
+        auto const bin = bin_of(header->n_units);
+
+        ++counts_[bin];
+        free_units_ += header->n_units;
+        largest_ = std::max(largest_, header->n_units);
+
+        header->next      = bins_[bin];
+        prev_link(header) = nullptr;
+
+        if (bins_[bin] != nullptr) {
+            prev_link(bins_[bin]) = header;
+        }
+
+        bins_[bin] = header;
+        bitmap_ |= 1ULL << bin;
+
+        if (header->n_units < small_units) {
+            ++small_counts_[header->n_units];
+            small_bitmap_ |= 1ULL << header->n_units;
+        }
+        else {
+            root_ = avl::insert(root_, to_node(header));
+        }
+
+        set_footer(header);
+    }
+
+    void Remove(header_t* header) noexcept
+    {
+        auto const bin  = bin_of(header->n_units);
+        auto const prev = prev_link(header);
+
+        if (header->next != nullptr) {
+            prev_link(header->next) = prev;
+        }
+
+        if (prev != nullptr) {
+            prev->next = header->next;
+        }
+        else if ((bins_[bin] = header->next) == nullptr) {
+            bitmap_ &= ~(1ULL << bin);
+        }
+
+        --counts_[bin];
+        free_units_ -= header->n_units;
+
+        if (header->n_units < small_units) {
+            if (--small_counts_[header->n_units] == 0) {
+                small_bitmap_ &= ~(1ULL << header->n_units);
+            }
+        }
+        else {
+            root_ = avl::remove(root_, to_node(header));
+        }
+
+        if (header->n_units == largest_) {
+            largest_ = find_largest();
+        }
+    }
+
+    // n_units以上の空きブロックをビンから外して返す。
+    // n_unitsのビンはファーストフィットで探し、無ければそれより上の空でない最小のビンの先頭を使う
+    header_t* Take(size_t n_units) noexcept
+    {
+        auto const bin = bin_of(n_units);
+
+        auto found = bins_[bin];
+        for (; found != nullptr && found->n_units < n_units; found = found->next) {
+            ;
+        }
+
+        if (found == nullptr) {
+            auto const upper = bin + 1 < n_bins ? bitmap_ & (~0ULL << (bin + 1)) : 0;
+
+            if (upper == 0) {
+                return nullptr;
+            }
+
+            found = bins_[__builtin_ctzll(upper)];
+        }
+
+        Remove(found);
+
+        return found;
+    }
+
+    header_t const* First() const noexcept { return first_from(0); }
+
+    header_t const* Next(header_t const* header) const noexcept
+    {
+        return header->next != nullptr ? header->next : first_from(bin_of(header->n_units) + 1);
+    }
+
+private:
+    static constexpr size_t small_units{64};  // これ未満のn_unitsはAVL木に入れず、個数のみ数える
+
+    struct tree_node {
+        header_t   header;
+        header_t*  prev;  // prev_link(header)
+        tree_node* left;
+        tree_node* right;
+        size_t     height;
+    };
+
+    static_assert(sizeof(tree_node) < small_units * unit_size);
+
+public:
+    // 空きブロックの先頭で管理情報(ヘッダ、逆リンク、木のノード)が使うユニット数。free_treeと同じ
+    static constexpr size_t head_units{Roundup(unit_size, sizeof(tree_node)) / unit_size};
+
+    // 空きブロックを辿らないO(1)
+    FreeBlockStats GetStats() const noexcept
+    {
+        constexpr auto unit_shift = static_cast<size_t>(__builtin_ctzll(unit_size));
+        static_assert((1U << unit_shift) == unit_size);
+
+        auto stats = FreeBlockStats{free_units_ * unit_size,
+                                    largest_ * unit_size,
+                                    largest_ == 0 ? 0 : (largest_ - 1) * unit_size,  // ヘッダの分を除く
+                                    0,
+                                    {}};
+
+        for (auto bin = 0U; bin + unit_shift < FreeBlockStats::histogram_size; ++bin) {
+            stats.histogram[bin + unit_shift] = counts_[bin];
+            stats.free_blocks += counts_[bin];
+        }
+
+        return stats;
+    }
+
+private:
+    static constexpr size_t n_bins{64};
+
+    using avl = avl_tree<tree_node>;
+
+    header_t*  bins_[n_bins]{};
+    uint64_t   bitmap_{0};
+    uint32_t   counts_[n_bins]{};             // ビン毎の空きブロック数
+    uint32_t   small_counts_[small_units]{};  // n_units毎の空きブロック数
+    uint64_t   small_bitmap_{0};
+    tree_node* root_{nullptr};  // small_units以上の空きブロック
+    size_t     free_units_{0};
+    size_t     largest_{0};  // 最大の空きブロックのn_units
+
+    static size_t bin_of(size_t n_units) noexcept { return 63 - __builtin_clzll(n_units); }
+
+    static tree_node* to_node(header_t* header) noexcept { return reinterpret_cast<tree_node*>(header); }
+
+    // AVL木の右端、木が空ならn_unitsの個数のビットマップの最上位。O(log n)
+    size_t find_largest() const noexcept
+    {
+        if (auto const max = avl::max(root_); max != nullptr) {
+            return max->header.n_units;
+        }
+
+        return small_bitmap_ == 0 ? 0 : 63 - __builtin_clzll(small_bitmap_);
+    }
+
+    header_t const* first_from(size_t bin) const noexcept
+    {
+        auto const bits = bin < n_bins ? bitmap_ & (~0ULL << bin) : 0;
+
+        return bits == 0 ? nullptr : bins_[__builtin_ctzll(bits)];
+    }
+};
+
+// binsからn_units以上のブロックを取り出し、余りをbinsに戻す。
+// endはブロックが存在しない最初のアドレス(番兵ブロックで終端する場合はnullptr)。
+// BINSはfree_binsかfree_tree.hのfree_tree
+template <typename BINS>
+header_t* alloc_block(BINS& bins, size_t n_units, header_t const* end) noexcept
+{
+    auto curr = bins.Take(n_units);
+
+    if (curr == nullptr) {
+        return nullptr;
+    }
+
+    auto const n_free = curr->n_units;
+
+    sprit(curr, n_units);  // 分割できた場合、curr->n_unitsはn_unitsになる
+
+    auto next = curr + curr->n_units;
+
+    if (curr->n_units != n_free) {
+        bins.Insert(next);
+    }
+    else if (next != end) {
+        set_used(next, used_tag::prev_used);
+    }
+
+    set_used(curr, used_tag::prev_used);  // 空きブロック同士は隣接しないため、直前は常に使用中
+
+    return curr;
+}
+
+// headerを前後の空きブロックと結合してbinsに戻す。endはalloc_blockと同じ
+template <typename BINS>
+void free_block(BINS& bins, header_t* header, header_t const* end) noexcept
+{
+    assert(!is_free(header));
+
+    if (is_prev_free(header)) {
+        auto prev = prev_free_block(header);
+
+        bins.Remove(prev);
+        concat(prev, header);
+        header = prev;
+    }
+
+    if (auto next = header + header->n_units; next != end) {
+        if (is_free(next)) {
+            bins.Remove(next);
+            concat(header, next);
+        }
+        else {
+            set_used(next, used_tag::prev_free);
+        }
+    }
+
+    bins.Insert(header);
+}
 }  // namespace Inner_
 
 // @@@ sample begin 0:0
 
-template <uint32_t MEM_SIZE>
+template <uint32_t MEM_SIZE, typename LOCK = SpinLock>  // LOCKはMPoolFixedと同じ
 class MPoolVariable final : public MPool {
 public:
     // @@@ sample end
     // @@@ sample begin 0:1
     MPoolVariable() noexcept : MPool{MEM_SIZE}
     {
-        header_->next    = nullptr;
-        header_->n_units = sizeof(buff_) / Inner_::unit_size;
+        auto header = reinterpret_cast<Inner_::header_t*>(buff_.buffer);
+
+        header->n_units = sizeof(buff_) / Inner_::unit_size;
+        bins_.Insert(header);
     }
     // @@@ sample end
     // @@@ sample begin 0:2
 
     class const_iterator {
     public:
-        explicit const_iterator(Inner_::header_t const* header) noexcept : header_{header} {}
+        const_iterator(Inner_::free_bins const& bins, Inner_::header_t const* header) noexcept
+            : bins_{&bins}, header_{header}
+        {
+        }
         const_iterator(const_iterator const&) = default;
         const_iterator(const_iterator&&)      = default;
 
         const_iterator& operator++() noexcept  // 前置++のみ実装
         {
             assert(header_ != nullptr);
-            header_ = header_->next;
+            header_ = bins_->Next(header_);
 
             return *this;
         }
@@ -99,13 +572,23 @@ public:
         // clang-format on
 
     private:
-        Inner_::header_t const* header_;
+        Inner_::free_bins const* bins_;
+        Inner_::header_t const*  header_;
     };
 
-    const_iterator begin() const noexcept { return const_iterator{header_}; }
-    const_iterator end() const noexcept { return const_iterator{nullptr}; }
-    const_iterator cbegin() const noexcept { return const_iterator{header_}; }
-    const_iterator cend() const noexcept { return const_iterator{nullptr}; }
+    const_iterator begin() const noexcept { return const_iterator{bins_, bins_.First()}; }
+    const_iterator end() const noexcept { return const_iterator{bins_, nullptr}; }
+    const_iterator cbegin() const noexcept { return begin(); }
+    const_iterator cend() const noexcept { return end(); }
+
+    // 空きブロックの統計のスナップショット。const_iteratorと違い空きリストを辿らないため、
+    // 運用中に定期的に呼んで断片化を監視できる
+    FreeBlockStats GetFreeStats() const noexcept
+    {
+        auto lock = std::lock_guard{lock_};
+
+        return bins_.GetStats();
+    }
     // @@@ sample end
     // @@@ sample begin 0:3
 
@@ -113,37 +596,25 @@ private:
     using header_t = Inner_::header_t;
 
     Inner_::buffer_t<MEM_SIZE> buff_{};
-    header_t*                  header_{reinterpret_cast<header_t*>(buff_.buffer)};
-    mutable SpinLock           spin_lock_{};
+    Inner_::free_bins          bins_{};
+    mutable LOCK               lock_{};
     size_t                     unit_count_{sizeof(buff_) / Inner_::unit_size};
     size_t                     unit_count_min_{sizeof(buff_) / Inner_::unit_size};
 
+    header_t const* buff_end() const noexcept
+    {
+        return reinterpret_cast<header_t const*>(buff_.buffer + sizeof(buff_));
+    }
+
     virtual void* alloc(size_t size) noexcept override
     {
         // @@@ ignore begin
         // size分のメモリとヘッダ
         auto n_units = (Roundup(Inner_::unit_size, size) / Inner_::unit_size) + 1;
 
-        auto lock = std::lock_guard{spin_lock_};
-
-        auto curr = header_;
-
-        for (header_t* prev{nullptr}; curr != nullptr; prev = curr, curr = curr->next) {
-            auto opt_next = std::optional<header_t*>{sprit(curr, n_units)};
-
-            if (!opt_next) {
-                continue;
-            }
+        auto lock = std::lock_guard{lock_};
 
-            auto next = *opt_next;
-            if (prev == nullptr) {
-                header_ = next;
-            }
-            else {
-                prev->next = next;
-            }
-            break;
-        }
+        auto curr = Inner_::alloc_block(bins_, n_units, buff_end());
 
         if (curr != nullptr) {
             unit_count_ -= curr->n_units;
@@ -160,35 +631,12 @@ private:
         // @@@ ignore begin
         header_t* to_free = Inner_::set_back(mem);
 
-        to_free->next = nullptr;
-
-        auto lock = std::lock_guard{spin_lock_};
+        auto lock = std::lock_guard{lock_};
 
         unit_count_ += to_free->n_units;
         unit_count_min_ = std::min(unit_count_, unit_count_min_);
 
-        if (header_ == nullptr) {
-            header_ = to_free;
-            return;
-        }
-
-        if (to_free < header_) {
-            concat(to_free, header_);
-            header_ = to_free;
-            return;
-        }
-
-        header_t* curr = header_;
-
-        for (; curr->next != nullptr; curr = curr->next) {
-            if (to_free < curr->next) {  // 常に curr < to_free
-                concat(to_free, curr->next);
-                concat(curr, to_free);
-                return;
-            }
-        }
-
-        concat(curr, to_free);
+        Inner_::free_block(bins_, to_free, buff_end());  // 境界タグにより前後の空きブロックとO(1)で結合
         // @@@ ignore end
     }
 
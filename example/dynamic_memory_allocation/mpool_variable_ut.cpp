@@ -1,5 +1,7 @@
+#include <algorithm>
 #include <iomanip>
 #include <iostream>
+#include <memory>
 
 #include "gtest_wrapper.h"
 
@@ -362,4 +364,77 @@ TEST(NewDelete_Opt, allocator_itor2)
         std::cout << std::setw(16) << (*itor)->next << ":" << (*itor)->n_units << std::endl;
     }
 }
+
+// const_iteratorで空きリストを辿って求めた統計
+template <typename MPV>
+FreeBlockStats walk_free_stats(MPV const& mpv)
+{
+    auto stats = FreeBlockStats{};
+
+    for (auto itor = mpv.cbegin(); itor != mpv.cend(); ++itor) {
+        auto const bytes = (*itor)->n_units * Inner_::unit_size;
+
+        stats.free_bytes += bytes;
+        stats.largest_block = std::max(stats.largest_block, bytes);
+        ++stats.free_blocks;
+        ++stats.histogram[63 - __builtin_clzll(bytes)];
+    }
+
+    return stats;
+}
+
+TEST(NewDelete_Opt, mpool_variable_free_stats)
+{
+    auto mpv = std::make_unique<MPoolVariable<1024 * 64>>();
+
+    // @@@ sample begin 5:0
+
+    auto stats = mpv->GetFreeStats();  // 空きリストを辿らないO(1)
+
+    ASSERT_EQ(1, stats.free_blocks);
+    ASSERT_EQ(mpv->GetCount(), stats.free_bytes);
+    ASSERT_EQ(0.0, stats.Fragmentation());
+    // @@@ sample end
+
+    constexpr size_t alloc_count = 100U;
+    void*            mem[alloc_count]{};
+
+    for (auto& m : mem) {
+        m = mpv->Alloc(100);  // ヘッダと合わせて128バイト
+    }
+
+    for (auto i = 0U; i < alloc_count; i += 2) {  // 1個おきに解放して断片化させる
+        mpv->Free(mem[i]);
+    }
+
+    stats = mpv->GetFreeStats();
+
+    auto const walked = walk_free_stats(*mpv);
+    ASSERT_EQ(walked.free_bytes, stats.free_bytes);
+    ASSERT_EQ(walked.largest_block, stats.largest_block);
+    ASSERT_EQ(walked.free_blocks, stats.free_blocks);
+    ASSERT_TRUE(std::equal(std::begin(walked.histogram), std::end(walked.histogram), std::begin(stats.histogram)));
+
+    ASSERT_EQ(alloc_count / 2 + 1, stats.free_blocks);  // 128バイトが50個と末尾の1個
+    ASSERT_EQ(alloc_count / 2, stats.histogram[7]);
+    ASSERT_LT(0.0, stats.Fragmentation());
+
+    // 最大の空きブロックを使い切ると、次に大きいブロックが最大になる
+    auto large = mpv->Alloc(stats.max_alloc_size);
+    ASSERT_EQ(nullptr, mpv->AllocNoExcept(stats.max_alloc_size));
+
+    stats = mpv->GetFreeStats();
+    ASSERT_EQ(128, stats.largest_block);
+    ASSERT_EQ(alloc_count / 2, stats.free_blocks);
+
+    mpv->Free(large);
+    for (auto i = 1U; i < alloc_count; i += 2) {
+        mpv->Free(mem[i]);
+    }
+
+    stats = mpv->GetFreeStats();
+    ASSERT_EQ(1, stats.free_blocks);
+    ASSERT_EQ(0.0, stats.Fragmentation());
+    ASSERT_EQ(stats.largest_block, stats.max_alloc_size + Inner_::unit_size);
+}
 }  // namespace
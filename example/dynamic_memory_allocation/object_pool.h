@@ -0,0 +1,221 @@
+#pragma once
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <type_traits>
+
+#include "mpool.h"
+#include "mpool_magazine.h"
+#include "spin_lock.h"
+
+// @@@ sample begin 0:0
+
+struct ObjectPoolNoReset {  // ObjectPoolのデフォルト。返却されたオブジェクトに何もしない
+    template <typename T>
+    void operator()(T&) const noexcept
+    {
+    }
+};
+
+struct ObjectPoolClear {  // std::stringやstd::vector等。clear()は内部のメモリを解放しない
+    template <typename T>
+    void operator()(T& obj) const noexcept
+    {
+        obj.clear();
+    }
+};
+// @@@ sample end
+// @@@ sample begin 1:0
+
+namespace Inner_ {
+struct object_slot {  // ObjectPoolのフリーリストのノード。slots_[i]がobjs_[i]に対応する
+    object_slot* next;
+};
+}  // namespace Inner_
+
+// 構築済みのTをN個持ち、それを貸し出すプール。
+// OpNew<T>はメモリしか再利用しないため、再利用のたびにコンストラクタとデストラクタが走り、
+// std::string等はその内部のメモリを確保し直すことになる。
+// ObjectPoolは返却されたオブジェクトを解体せず、RESETでリセットしてフリーリストに戻すため、内部のメモリも再利用される。
+// CACHE、LOCKはMPoolFixedと同じ
+template <typename T, uint32_t N, typename RESET = ObjectPoolNoReset, typename CACHE = MPoolFixedNoCache,
+          typename LOCK = SpinLock>
+class ObjectPool {
+public:
+    static_assert(N > 0);
+    static_assert(std::is_nothrow_invocable_v<RESET, T&>);
+
+    // 全オブジェクトをargsから構築する
+    template <typename... ARGS>
+    explicit ObjectPool(ARGS const&... args)
+    {
+        auto i = size_t{0};
+
+        try {
+            for (; i < N; ++i) {
+                ::new (&objs_[i]) T{args...};
+                slots_[i].next = i + 1 < N ? &slots_[i + 1] : nullptr;
+            }
+        }
+        catch (...) {
+            while (i != 0) {
+                at(--i)->~T();
+            }
+            throw;
+        }
+    }
+
+    ~ObjectPool()
+    {
+        assert(GetCount() == N);  // 貸し出し中のオブジェクトが残っていてはならない
+
+        for (auto i = size_t{0}; i < N; ++i) {
+            at(i)->~T();
+        }
+    }
+
+    ObjectPool(ObjectPool const&)            = delete;
+    ObjectPool& operator=(ObjectPool const&) = delete;
+
+    // 空であればnullptr
+    T* Acquire() noexcept
+    {
+        auto slot = acquire_slot();
+
+        return slot == nullptr ? nullptr : at(slot - slots_);
+    }
+
+    void Release(T* obj) noexcept
+    {
+        assert(IsValid(obj));
+
+        RESET{}(*obj);
+        release_slot(&slots_[obj - at(0)]);
+    }
+
+    class Deleter {
+    public:
+        explicit Deleter(ObjectPool* pool = nullptr) noexcept : pool_{pool} {}
+        void operator()(T* obj) const noexcept { pool_->Release(obj); }
+
+    private:
+        ObjectPool* pool_;
+    };
+
+    using Ptr = std::unique_ptr<T, Deleter>;
+
+    // 破棄時にRelease()するunique_ptrで返す。空であればMPoolBadAllocを送出する
+    Ptr Get()
+    {
+        auto obj = Acquire();
+
+        if (obj == nullptr) {
+            throw MAKE_EXCEPTION(MPoolBadAlloc, "ObjectPool : out of objects");
+        }
+
+        return Ptr{obj, Deleter{this}};
+    }
+
+    // 貸し出せるオブジェクトの数。マガジン使用時は各スレッドのマガジンにあるものも含む
+    size_t GetCount() const noexcept { return count_ + cache_.count(); }
+    size_t GetCountMin() const noexcept { return count_min_; }  // 共有フリーリストの最小値
+
+    bool IsValid(T const* obj) const noexcept { return at(0) <= obj && obj < at(0) + N; }
+
+private:
+    using slot_t  = Inner_::object_slot;
+    using cache_t = Inner_::magazine_cache<slot_t, CACHE>;
+
+    struct alignas(T) storage_t {
+        uint8_t buff[sizeof(T)];
+    };
+
+    storage_t    objs_[N];
+    slot_t       slots_[N];
+    slot_t*      head_{&slots_[0]};
+    size_t       count_{N};
+    size_t       count_min_{N};
+    mutable LOCK lock_{};
+    cache_t      cache_{};
+
+    // 終了したスレッドのマガジンのスロットを共有フリーリストに戻す。MPoolFixedと同じく最後に置く
+    typename cache_t::exit_hook_t exit_hook_{
+        [](void* ctx, uint32_t slot) noexcept { static_cast<ObjectPool*>(ctx)->drain_magazine(slot); }, this};
+
+    T*       at(size_t i) noexcept { return std::launder(reinterpret_cast<T*>(&objs_[i])); }
+    T const* at(size_t i) const noexcept { return std::launder(reinterpret_cast<T const*>(&objs_[i])); }
+
+    // 先頭から最大n個のスロットをまとめて外す。外した個数はpoppedに返す
+    slot_t* pop_slots(uint32_t n, uint32_t& popped) noexcept
+    {
+        auto lock = std::lock_guard{lock_};
+
+        auto    head = head_;
+        slot_t* tail{nullptr};
+
+        for (popped = 0; popped < n && head_ != nullptr; ++popped) {
+            tail  = head_;
+            head_ = head_->next;
+        }
+
+        if (tail != nullptr) {
+            tail->next = nullptr;
+            count_ -= popped;
+            count_min_ = std::min(count_, count_min_);
+        }
+
+        return tail == nullptr ? nullptr : head;
+    }
+
+    void push_slots(slot_t* head, slot_t* tail, uint32_t n) noexcept
+    {
+        auto lock = std::lock_guard{lock_};
+
+        tail->next = head_;
+        head_      = head;
+        count_ += n;
+    }
+
+    void drain_magazine(uint32_t slot) noexcept
+    {
+        if constexpr (cache_t::enabled) {
+            auto spill = [this](slot_t* head, slot_t* tail, uint32_t n) noexcept { push_slots(head, tail, n); };
+
+            cache_.drain(slot, spill);
+        }
+    }
+
+    slot_t* acquire_slot() noexcept
+    {
+        if constexpr (cache_t::enabled) {
+            if (auto mag = cache_.get(); mag != nullptr) {
+                auto refill = [this](uint32_t n, uint32_t& popped) noexcept { return pop_slots(n, popped); };
+
+                return cache_t::pop(*mag, refill);
+            }
+        }
+
+        auto popped = uint32_t{0};
+
+        return pop_slots(1, popped);
+    }
+
+    void release_slot(slot_t* slot) noexcept
+    {
+        if constexpr (cache_t::enabled) {
+            if (auto mag = cache_.get(); mag != nullptr) {
+                auto spill = [this](slot_t* head, slot_t* tail, uint32_t n) noexcept { push_slots(head, tail, n); };
+
+                cache_t::push(*mag, slot, spill);
+                return;
+            }
+        }
+
+        push_slots(slot, slot, 1);
+    }
+};
+// @@@ sample end
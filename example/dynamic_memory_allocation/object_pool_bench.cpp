@@ -0,0 +1,49 @@
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+
+#include "gtest_wrapper.h"
+
+#include "dynamic_memory_allocation_ut.h"
+#include "object_pool.h"
+
+namespace {
+// 応答バッファとして100～400文字のstd::stringを生成して捨てる処理の1回あたりの所要時間
+template <typename GET>
+double reply_buffer_ns(GET&& get)
+{
+    using clock = std::chrono::steady_clock;
+
+    constexpr auto rounds = 256 * 1024U;
+
+    auto const begin = clock::now();
+
+    for (auto i = 0U; i < rounds; ++i) {
+        auto reply = get();
+
+        reply->assign(100 + i % 301, 'r');
+    }
+
+    return std::chrono::duration<double, std::nano>(clock::now() - begin).count() / rounds;
+}
+
+TEST(NewDelete_Opt, object_pool_benchmark)
+{
+    // @@@ sample begin 0:0
+
+    auto pool     = ObjectPool<std::string, 16, ObjectPoolClear>{};
+    auto pool_mag = ObjectPool<std::string, 16, ObjectPoolClear, MPoolFixedMagazine<4>>{};
+
+    auto const make_unique = reply_buffer_ns([] { return std::make_unique<std::string>(); });
+    auto const object_pool = reply_buffer_ns([&pool] { return pool.Get(); });
+    auto const magazine    = reply_buffer_ns([&pool_mag] { return pool_mag.Get(); });
+
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << "std::make_unique<std::string>  " << std::setw(8) << make_unique << " [ns/op]" << std::endl;
+    std::cout << "ObjectPool                     " << std::setw(8) << object_pool << " [ns/op]" << std::endl;
+    std::cout << "ObjectPool + MPoolFixedMagazine" << std::setw(8) << magazine << " [ns/op]" << std::endl;
+    // @@@ sample end
+}
+}  // namespace
@@ -0,0 +1,153 @@
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "gtest_wrapper.h"
+
+#include "dynamic_memory_allocation_ut.h"
+#include "object_pool.h"
+
+namespace {
+TEST(NewDelete_Opt, object_pool)
+{
+    // @@@ sample begin 0:0
+
+    auto pool = ObjectPool<std::string, 4, ObjectPoolClear>{};  // 構築済みのstd::stringを4個持つ
+
+    ASSERT_EQ(4, pool.GetCount());
+
+    std::string const* addr{nullptr};
+    auto               capacity = size_t{0};
+    {
+        auto reply = pool.Get();  // unique_ptr<std::string, ObjectPool::Deleter>
+
+        reply->assign(1000, 'x');
+        addr     = reply.get();
+        capacity = reply->capacity();
+        ASSERT_EQ(3, pool.GetCount());
+    }  // 解体されずにclear()されてプールへ戻る
+    ASSERT_EQ(4, pool.GetCount());
+
+    auto reply = pool.Get();  // 最後に返却されたオブジェクトが再び貸し出される
+
+    ASSERT_EQ(addr, reply.get());
+    ASSERT_TRUE(reply->empty());
+    ASSERT_EQ(capacity, reply->capacity());  // 内部のメモリは保持されている
+    // @@@ sample end
+
+    std::string* strs[3]{};
+    for (auto& s : strs) {
+        s = pool.Acquire();
+        ASSERT_TRUE(pool.IsValid(s));
+    }
+
+    ASSERT_EQ(0, pool.GetCount());
+    ASSERT_EQ(nullptr, pool.Acquire());
+    ASSERT_THROW(pool.Get(), MPoolBadAlloc);
+
+    for (auto s : strs) {
+        pool.Release(s);
+    }
+    ASSERT_EQ(3, pool.GetCount());
+    ASSERT_EQ(0, pool.GetCountMin());
+}
+
+struct Counted {
+    explicit Counted(int v) : value{v} { ++constructed; }
+    ~Counted() { ++destructed; }
+
+    int value;
+
+    inline static int constructed{0};
+    inline static int destructed{0};
+};
+
+struct ResetCounted {  // リセットフック
+    void operator()(Counted& c) const noexcept { c.value = 0; }
+};
+
+TEST(NewDelete_Opt, object_pool_reset)
+{
+    Counted::constructed = 0;
+    Counted::destructed  = 0;
+    {
+        auto pool = ObjectPool<Counted, 8, ResetCounted>{42};  // 全オブジェクトは42から構築される
+        ASSERT_EQ(8, Counted::constructed);
+
+        for (auto i = 0; i < 100; ++i) {
+            auto c = pool.Get();
+
+            ASSERT_EQ(i == 0 ? 42 : 0, c->value);  // 2回目以降はリセット済み
+            c->value = i + 1;
+        }
+
+        ASSERT_EQ(8, Counted::constructed);  // 貸し出しと返却ではコンストラクタもデストラクタも走らない
+        ASSERT_EQ(0, Counted::destructed);
+    }
+    ASSERT_EQ(8, Counted::destructed);
+}
+
+TEST(NewDelete_Opt, object_pool_magazine)
+{
+    constexpr auto n_threads = 4U;
+    constexpr auto live      = 8U;
+
+    // スレッドキャッシュ付き。共有フリーリストのロックは4回に1回
+    auto pool   = std::make_unique<ObjectPool<std::string, 256, ObjectPoolClear, MPoolFixedMagazine<4>>>();
+    auto errors = std::atomic<uint32_t>{0};
+
+    auto threads = std::vector<std::thread>{};
+    for (auto t = 0U; t < n_threads; ++t) {
+        threads.emplace_back([&pool, &errors] {
+            for (auto loop = 0U; loop < 1000; ++loop) {
+                decltype(pool->Get()) strs[live];
+
+                for (auto& s : strs) {
+                    s = pool->Get();
+                    if (!s->empty()) {  // 他スレッドが使用中のものや、リセットされていないものは貸し出されない
+                        ++errors;
+                    }
+                    s->assign(100, 'a');
+                }
+            }
+        });
+    }
+
+    for (auto& t : threads) {
+        t.join();
+    }
+
+    ASSERT_EQ(0, errors);
+    ASSERT_EQ(256, pool->GetCount());  // マガジンに残ったものも含む
+}
+
+TEST(NewDelete_Opt, object_pool_magazine_thread_exit)
+{
+    auto pool = ObjectPool<int, 8, ObjectPoolNoReset, MPoolFixedMagazine<2>>{};
+
+    pool.Release(pool.Acquire());  // このスレッドのマガジンに2個
+
+    auto th = std::thread{[&pool] {
+        pool.Release(pool.Acquire());  // マガジンに2個を残したまま終了する
+    }};
+    th.join();
+
+    ASSERT_EQ(4, pool.GetCountMin());
+    ASSERT_EQ(8, pool.GetCount());
+
+    int* objs[8]{};
+    for (auto& o : objs) {  // 終了したスレッドのマガジンの分は共有フリーリストに戻されている
+        o = pool.Acquire();
+        ASSERT_NE(nullptr, o);
+    }
+    ASSERT_EQ(nullptr, pool.Acquire());
+
+    for (auto o : objs) {
+        pool.Release(o);
+    }
+    ASSERT_EQ(8, pool.GetCount());
+}
+
+}  // namespace
@@ -1,4 +1,7 @@
 #pragma once
+#include <cstddef>
+#include <new>
+#include <type_traits>
 
 #include "mpool.h"
 
@@ -15,6 +18,50 @@ public:
     static void                operator delete[](void* mem) noexcept                   = delete;
     static void                operator delete[](void* mem, std::size_t size) noexcept = delete;
 
+    // UをN個まとめて生成し、objs[0]～objs[N - 1]に返す。メモリ確保は1回のAllocBatch()で行う。
+    // N個確保できなければMPoolBadAllocを送出し、途中でコンストラクタが送出した場合も何も残さない
+    template <typename U, size_t N, typename... ARGS>
+    static void NewBatch(U* (&objs)[N], ARGS const&... args)
+    {
+        static_assert(std::is_base_of_v<T, U>);
+
+        void* mem[N];
+
+        if (auto const got = mpool_.AllocBatch(sizeof(U), N, mem); got != N) {
+            mpool_.FreeBatch(mem, got);
+            throw MAKE_EXCEPTION(MPoolBadAlloc, "MPF : out of memory");
+        }
+
+        auto i = size_t{0};
+
+        try {
+            for (; i < N; ++i) {
+                objs[i] = ::new (mem[i]) U{args...};  // U::operator newはプレースメント形式を持たない
+            }
+        }
+        catch (...) {
+            while (i != 0) {
+                objs[--i]->~U();
+            }
+            mpool_.FreeBatch(mem, N);
+            throw;
+        }
+    }
+
+    // NewBatch()で生成したN個を解体し、1回のFreeBatch()で解放する
+    template <typename U, size_t N>
+    static void DeleteBatch(U* (&objs)[N]) noexcept
+    {
+        void* mem[N];
+
+        for (auto i = size_t{0}; i < N; ++i) {
+            objs[i]->~U();
+            mem[i] = objs[i];
+        }
+
+        mpool_.FreeBatch(mem, N);
+    }
+
 private:
     static MPool& mpool_;
 };
@@ -1,4 +1,8 @@
 #pragma once
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
 
 // @@@ sample begin 0:0
 
@@ -7,9 +11,16 @@
 class SpinLock {
 public:
     void lock() noexcept
+    {
+        lock([]() noexcept {});
+    }
+
+    // 待たされてスピンするたびにon_spin()を呼ぶ。ロックの競合の計測用
+    template <typename ON_SPIN>
+    void lock(ON_SPIN&& on_spin) noexcept
     {
         while (state_.exchange(state::locked, std::memory_order_acquire) == state::locked) {
-            ;  // busy wait
+            on_spin();  // busy wait
         }
     }
 
@@ -20,3 +31,221 @@ private:
     std::atomic<state> state_{state::unlocked};
 };
 // @@@ sample end
+// @@@ sample begin 1:0
+
+namespace Inner_ {
+inline void cpu_relax() noexcept  // スピン中であることをCPUに伝え、ロック保持者のパイプラインを邪魔しない
+{
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    asm volatile("yield");
+#endif
+}
+
+// 待ち時間を指数的に伸ばし、上限に達したらCPUを他スレッドに譲る
+class Backoff {
+public:
+    void Wait() noexcept
+    {
+        if (spins_ < spins_max_) {
+            for (auto i = 0U; i < spins_; ++i) {
+                cpu_relax();
+            }
+            spins_ *= 2;
+        }
+        else {
+            std::this_thread::yield();
+        }
+    }
+
+private:
+    static constexpr uint32_t spins_max_{1024};
+    uint32_t                  spins_{1};
+};
+
+struct mcs_node {
+    std::atomic<mcs_node*> next{nullptr};
+    std::atomic<bool>      locked{false};
+};
+
+// MCSLockのlock()/unlock()は引数を取らないため、ノードはスレッド毎に持ち、lock()で空きを1つ借りる。
+// 借りたノードはMCSLockが保持者のものとして覚えるため、ロックは取得順と無関係に解放してよい
+struct mcs_nodes {
+    static constexpr uint32_t nest_max{8};  // 1スレッドが同時に保持できるMCSLockの数
+
+    mcs_node node[nest_max];
+    uint32_t used{0};  // ビットiが1であればnode[i]は貸し出し中
+};
+
+inline mcs_nodes& thread_mcs_nodes() noexcept
+{
+    thread_local mcs_nodes nodes;
+
+    return nodes;
+}
+
+[[noreturn]] inline void mcs_node_abort(char const* msg) noexcept
+{
+    // キューが壊れたまま走り続けるとデッドロックやデータ競合になるため、リリースビルドでも止める
+    std::fprintf(stderr, "MCSLock : %s\n", msg);
+    std::abort();
+}
+
+inline mcs_node& mcs_node_acquire() noexcept
+{
+    constexpr auto all = (1U << mcs_nodes::nest_max) - 1;
+
+    auto& nodes = thread_mcs_nodes();
+
+    if (nodes.used == all) {
+        mcs_node_abort("too many locks held by one thread");
+    }
+
+    auto const i = static_cast<uint32_t>(__builtin_ctz(~nodes.used));
+    nodes.used |= 1U << i;
+
+    return nodes.node[i];
+}
+
+inline void mcs_node_release(mcs_node* node) noexcept
+{
+    auto&      nodes = thread_mcs_nodes();
+    auto const i     = (reinterpret_cast<uintptr_t>(node) - reinterpret_cast<uintptr_t>(nodes.node)) / sizeof(mcs_node);
+
+    if (i >= mcs_nodes::nest_max || (nodes.used & (1U << i)) == 0) {
+        mcs_node_abort("unlocked by a thread that does not hold it");
+    }
+
+    nodes.used &= ~(1U << i);
+}
+}  // namespace Inner_
+// @@@ sample end
+// @@@ sample begin 2:0
+
+// test and test-and-set + 指数バックオフ。
+// 読み出しだけでロックの解放を待つため、待機中のスレッドがキャッシュラインを奪い合わない
+class SpinLockTTAS {
+public:
+    void lock() noexcept
+    {
+        lock([]() noexcept {});
+    }
+
+    template <typename ON_SPIN>  // on_spinはSpinLockと同じ
+    void lock(ON_SPIN&& on_spin) noexcept
+    {
+        auto backoff = Inner_::Backoff{};
+
+        for (;;) {
+            if (!locked_.exchange(true, std::memory_order_acquire)) {
+                return;
+            }
+
+            while (locked_.load(std::memory_order_relaxed)) {
+                on_spin();
+                backoff.Wait();
+            }
+        }
+    }
+
+    void unlock() noexcept { locked_.store(false, std::memory_order_release); }
+
+private:
+    std::atomic<bool> locked_{false};
+};
+// @@@ sample end
+// @@@ sample begin 3:0
+
+// チケットロック。到着順にロックを得るため、待ち時間が公平になる
+class TicketLock {
+public:
+    void lock() noexcept
+    {
+        lock([]() noexcept {});
+    }
+
+    template <typename ON_SPIN>  // on_spinはSpinLockと同じ
+    void lock(ON_SPIN&& on_spin) noexcept
+    {
+        auto const ticket  = next_.fetch_add(1, std::memory_order_relaxed);
+        auto       backoff = Inner_::Backoff{};
+
+        while (serving_.load(std::memory_order_acquire) != ticket) {
+            on_spin();
+            backoff.Wait();
+        }
+    }
+
+    void unlock() noexcept
+    {
+        // serving_を書くのはロック保持者だけ
+        serving_.store(serving_.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+private:
+    std::atomic<uint32_t> next_{0};
+    std::atomic<uint32_t> serving_{0};
+};
+// @@@ sample end
+// @@@ sample begin 4:0
+
+// MCSキューロック。各スレッドは自分のノードだけをスピンするため、
+// 待機スレッドが増えてもロックのキャッシュラインへのアクセスは増えない
+class MCSLock {
+public:
+    void lock() noexcept
+    {
+        lock([]() noexcept {});
+    }
+
+    template <typename ON_SPIN>  // on_spinはSpinLockと同じ
+    void lock(ON_SPIN&& on_spin) noexcept
+    {
+        auto& node = Inner_::mcs_node_acquire();
+
+        node.next.store(nullptr, std::memory_order_relaxed);
+        node.locked.store(true, std::memory_order_relaxed);
+
+        auto prev = tail_.exchange(&node, std::memory_order_acq_rel);
+
+        if (prev != nullptr) {
+            prev->next.store(&node, std::memory_order_release);
+
+            auto backoff = Inner_::Backoff{};
+            while (node.locked.load(std::memory_order_acquire)) {
+                on_spin();
+                backoff.Wait();
+            }
+        }
+
+        holder_ = &node;  // holder_を読み書きするのはロック保持者だけ
+    }
+
+    void unlock() noexcept
+    {
+        Inner_::mcs_node_release(holder_);  // このスレッドが次にlock()するまで、nodeは再利用されない
+
+        auto& node = *holder_;
+        auto  next = node.next.load(std::memory_order_acquire);
+
+        if (next == nullptr) {
+            auto expected = &node;
+            if (tail_.compare_exchange_strong(expected, nullptr, std::memory_order_acq_rel)) {
+                return;  // 待機スレッドなし
+            }
+
+            auto backoff = Inner_::Backoff{};
+            while ((next = node.next.load(std::memory_order_acquire)) == nullptr) {  // 後続がつながるのを待つ
+                backoff.Wait();
+            }
+        }
+
+        next->locked.store(false, std::memory_order_release);
+    }
+
+private:
+    std::atomic<Inner_::mcs_node*> tail_{nullptr};
+    Inner_::mcs_node*              holder_{nullptr};
+};
+// @@@ sample end
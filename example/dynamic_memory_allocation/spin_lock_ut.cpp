@@ -0,0 +1,135 @@
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "gtest_wrapper.h"
+
+#include "dynamic_memory_allocation_ut.h"
+#include "spin_lock.h"
+
+namespace {
+template <typename LOCK>
+uint32_t count_up_mt(uint32_t n_threads, uint32_t loops)
+{
+    auto lock  = LOCK{};
+    auto count = uint32_t{0};  // lockで保護する
+    auto ths   = std::vector<std::thread>{};
+
+    for (auto t = 0U; t < n_threads; ++t) {
+        ths.emplace_back([&lock, &count, loops] {
+            for (auto i = 0U; i < loops; ++i) {
+                auto guard = std::lock_guard{lock};
+                ++count;
+            }
+        });
+    }
+
+    for (auto& th : ths) {
+        th.join();
+    }
+
+    return count;
+}
+
+TEST(NewDelete_Opt, lock_policy)
+{
+    ASSERT_EQ(8 * 1000, count_up_mt<SpinLock>(8, 1000));
+    ASSERT_EQ(8 * 1000, count_up_mt<SpinLockTTAS>(8, 1000));
+    ASSERT_EQ(8 * 1000, count_up_mt<TicketLock>(8, 1000));
+    ASSERT_EQ(8 * 1000, count_up_mt<MCSLock>(8, 1000));
+}
+
+// 保持中のロックを別スレッドにlock(on_spin)させ、on_spinが呼ばれた回数を返す
+template <typename LOCK>
+uint64_t spins_while_held()
+{
+    auto lock  = LOCK{};
+    auto spins = uint64_t{0};  // waiterだけが書き、join()の後に読む
+
+    lock.lock();
+
+    auto waiter = std::thread{[&lock, &spins] {
+        lock.lock([&spins]() noexcept { ++spins; });  // 下のunlock()までスピンする
+        lock.unlock();
+    }};
+
+    std::this_thread::sleep_for(std::chrono::milliseconds{10});
+    lock.unlock();
+    waiter.join();
+
+    return spins;
+}
+
+TEST(NewDelete_Opt, lock_policy_spins)
+{
+    auto lock  = SpinLock{};
+    auto spins = uint64_t{0};
+
+    lock.lock([&spins]() noexcept { ++spins; });  // 競合が無ければスピンしない
+    lock.unlock();
+    ASSERT_EQ(0, spins);
+
+    ASSERT_LT(0, spins_while_held<SpinLock>());
+    ASSERT_LT(0, spins_while_held<SpinLockTTAS>());
+    ASSERT_LT(0, spins_while_held<TicketLock>());
+    ASSERT_LT(0, spins_while_held<MCSLock>());
+}
+
+TEST(NewDelete_Opt, mcs_lock_nested)
+{
+    auto lock0 = MCSLock{};
+    auto lock1 = MCSLock{};
+
+    {
+        auto guard0 = std::lock_guard{lock0};
+        auto guard1 = std::lock_guard{lock1};  // 1スレッドで複数のMCSLockを保持できる
+    }
+
+    ASSERT_EQ(2 * 1000, count_up_mt<MCSLock>(2, 1000));
+}
+
+TEST(NewDelete_Opt, mcs_lock_unordered_unlock)
+{
+    auto lock0 = MCSLock{};
+    auto lock1 = MCSLock{};
+    auto count = uint32_t{0};  // lock0で保護する
+    auto ths   = std::vector<std::thread>{};
+
+    for (auto t = 0U; t < 4; ++t) {
+        ths.emplace_back([&lock0, &lock1, &count] {
+            for (auto i = 0U; i < 1000; ++i) {
+                lock0.lock();
+                lock1.lock();
+                ++count;
+                lock0.unlock();  // 取得順と同じ順で解放しても、キューのノードは入れ替わらない
+                lock1.unlock();
+            }
+        });
+    }
+
+    for (auto& th : ths) {
+        th.join();
+    }
+
+    ASSERT_EQ(4 * 1000, count);
+}
+
+TEST(NewDelete_Opt, mcs_lock_misuse)
+{
+    auto locks = std::vector<MCSLock>(Inner_::mcs_nodes::nest_max + 1);
+
+    for (auto i = 0U; i < Inner_::mcs_nodes::nest_max; ++i) {
+        locks[i].lock();
+    }
+
+    // 保持数の上限を超えたlock()や、保持していないロックのunlock()はリリースビルドでも異常終了する
+    ASSERT_DEATH(locks.back().lock(), "too many locks");
+    ASSERT_DEATH(locks.back().unlock(), "does not hold");
+
+    for (auto i = 0U; i < Inner_::mcs_nodes::nest_max; ++i) {
+        locks[i].unlock();
+    }
+}
+}  // namespace
@@ -0,0 +1,7 @@
+#!/bin/bash -e
+
+readonly BASE_DIR=$(cd $(dirname $0); pwd)
+readonly BASENAME="$(basename $0)"
+
+export SAN_BUILD=false
+$BASE_DIR/../../essential/build/build_core.sh $BASE_DIR $@